@@ -1,6 +1,7 @@
 #!/bin/bash
-SOURCES="choice.cpp agent.cpp pod_agent.cpp game.cpp pod_game.cpp pod_game_generator.cpp game_generator.cpp utility.cpp evaluator.cpp tree_evaluator.cpp"
-HEADERS="types.hpp utility.hpp agent.hpp pod_agent.hpp choice.hpp evaluator.hpp tree_evaluator.hpp game.hpp pod_game.hpp game_generator.hpp pod_game_generator.hpp"
+SOURCES="choice.cpp agent.cpp pod_agent.cpp game.cpp pod_game.cpp pod_replay.cpp pod_game_generator.cpp game_generator.cpp utility.cpp evaluator.cpp tree_evaluator.cpp"
+# profiling, tracing and run logs are stubbed out by codingame_stubs.hpp
+HEADERS="types.hpp utility.hpp codingame_stubs.hpp agent.hpp pod_agent.hpp pod_replay.hpp choice.hpp evaluator.hpp tree_evaluator.hpp game.hpp pod_game.hpp game_generator.hpp pod_game_generator.hpp"
 FILES="$HEADERS $SOURCES"
 BRAIN=$(cat $1)
 
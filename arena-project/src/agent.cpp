@@ -12,6 +12,9 @@
 #include "evaluator.hpp"
 #include "game.hpp"
 #include "pod_agent.hpp"
+#include "profiling.hpp"
+#include "run_log.hpp"
+#include "trace.hpp"
 #include "utility.hpp"
 
 using namespace std;
@@ -70,11 +73,7 @@ agent_ptr deserialize_agent(stringstream &ss) {
 }
 
 agent::agent() {
-  static MutexType lock;
-  lock.Lock();
-  id = idc++;
-  lock.Unlock();
-
+  assign_id();
   original_id = id;
   rank = 0;
   last_rank = 0;
@@ -91,11 +90,20 @@ agent::agent() {
   csel = choice_selector_ptr(new choice_selector(0.2));
 }
 
+// give the agent a fresh id, clones must not share ids with their source
+void agent::assign_id() {
+  static MutexType lock;
+  lock.Lock();
+  id = idc++;
+  lock.Unlock();
+}
+
 void agent::train(vector<vector<record>> results, input_sampler isam) {
+  TRACE_SPAN("train", id);
   // Test outputs
   int ntest = 20;
   vector<vec> test_inputs(ntest);
-  vector<double> test_outputs(ntest);
+  vec test_outputs(ntest);
   for (int i = 0; i < ntest; i++) {
     record r = isam();
     test_inputs[i] = vec_append(r.opts[r.selected_option].choice, r.state);
@@ -106,6 +114,7 @@ void agent::train(vector<vector<record>> results, input_sampler isam) {
   double gamma = 1 - future_discount;
   for (auto &res : results) {
     int n = res.size();
+    profiling::count(profiling::PC_SAMPLES, n);
     res.back().sum_future_rewards = res.back().reward;
     for (int i = n - 2; i >= 0; i--) {
       float r = res[i].reward;
@@ -120,7 +129,7 @@ void agent::train(vector<vector<record>> results, input_sampler isam) {
   bool success = !!upd;
 
   // Test outputs
-  vector<double> test_outputs2(ntest), diffs(ntest);
+  vec test_outputs2(ntest), diffs(ntest);
   for (int i = 0; i < ntest; i++) {
     test_outputs2[i] = eval->evaluate(test_inputs[i]);
     diffs[i] = test_outputs2[i] - test_outputs[i];
@@ -182,11 +191,11 @@ agent_ptr agent::mate(agent_ptr p) const {
   a->ancestors.insert(id);
   a->ancestors.insert(p->id);
   a->original_id = a->id;
-  a->future_discount = join_vals({future_discount, p->future_discount});
-  a->w_reg = join_vals({w_reg, p->w_reg});
-  a->inspiration_age_limit = join_vals({(double)inspiration_age_limit, (double)p->inspiration_age_limit});
-  a->learning_rate = join_vals({(double)learning_rate, (double)p->learning_rate});
-  a->step_limit = join_vals({(double)step_limit, (double)p->step_limit});
+  a->future_discount = join_vals({(scalar)future_discount, (scalar)p->future_discount});
+  a->w_reg = join_vals({(scalar)w_reg, (scalar)p->w_reg});
+  a->inspiration_age_limit = join_vals({(scalar)inspiration_age_limit, (scalar)p->inspiration_age_limit});
+  a->learning_rate = join_vals({(scalar)learning_rate, (scalar)p->learning_rate});
+  a->step_limit = join_vals({(scalar)step_limit, (scalar)p->step_limit});
   a->use_f0c = use_f0c == p->use_f0c ? use_f0c : u01() > 0.5;
   return a->mutate();
 }
@@ -275,27 +284,83 @@ void agent::deserialize(std::stringstream &ss) {
 }
 
 record agent::select_choice(game_ptr g) {
+  record r = prepare_choice(g);
+  evaluate_options(r);
+  finalize_choice(r);
+  return r;
+}
+
+vec agent::decide(game_ptr g) {
+  auto opts = g->generate_choices(shared_from_this());
+  vec state = g->vectorize_state(id);
+
+  // ranked selection only needs the best option, which some evaluators know without scoring the options
+  bool greedy = csel->schema == CS_RANKED;
+  if (greedy) {
+    int k = csel->explore(opts.size());
+    vec best;
+    if (k >= 0 || eval->best_choice(state, best)) {
+      profiling::count(profiling::PC_DECISIONS);
+      return k >= 0 ? g->vectorize_choice(opts[k], id) : best;
+    }
+  }
+
+  vector<vec> choices(opts.size()), inputs(opts.size());
+  vector<const vec *> input_ptrs(opts.size());
+  vec outputs(opts.size());
+  for (int i = 0; i < opts.size(); i++) {
+    choices[i] = g->vectorize_choice(opts[i], id);
+    inputs[i] = vec_append(choices[i], state);
+    input_ptrs[i] = &inputs[i];
+  }
+
+  eval->evaluate_batch(input_ptrs, outputs.data());
+  profiling::count(profiling::PC_EVALUATIONS, opts.size());
+  profiling::count(profiling::PC_DECISIONS);
+  return choices[greedy ? csel->best(outputs.data(), outputs.size()) : csel->select(outputs.data(), outputs.size())];
+}
+
+// vectorize state and options, outputs are filled in by evaluate_options
+record agent::prepare_choice(game_ptr g) {
   record r;
   auto opts = g->generate_choices(shared_from_this());
 
   r.state = g->vectorize_state(id);
   r.opts.resize(opts.size());
+  r.selected_option = -1;
   r.reward = 0;
   r.sum_future_rewards = 0;
 
   for (int i = 0; i < opts.size(); i++) {
     r.opts[i].choice = g->vectorize_choice(opts[i], id);
     r.opts[i].input = vec_append(r.opts[i].choice, r.state);
-    r.opts[i].output = evaluate_choice(r.opts[i].input);
+    r.opts[i].output = 0;
   }
 
+  return r;
+}
+
+void agent::evaluate_options(record &r) {
+  vector<const vec *> inputs(r.opts.size());
+  vec outputs(r.opts.size());
+  for (int i = 0; i < r.opts.size(); i++) inputs[i] = &r.opts[i].input;
+
+  eval->evaluate_batch(inputs, outputs.data());
+  profiling::count(profiling::PC_EVALUATIONS, r.opts.size());
+  for (int i = 0; i < r.opts.size(); i++) r.opts[i].output = outputs[i];
+}
+
+void agent::finalize_choice(record &r) {
   r.selected_option = csel->select(r.opts);
+  profiling::count(profiling::PC_DECISIONS);
+}
 
-  return r;
+// the fields of dvalue::serialize
+void append_dvalue(log_row &row, const dvalue &x) {
+  row.f64(x.current).f64(x.last).f64(x.value_ma).f64(x.sd_ma).f64(x.diff_ma).f64(x.n);
 }
 
-string agent::status_report() const {
-  stringstream ss;
+void agent::status_report(log_row &row) const {
   vector<int> parent_ids(parents.begin(), parents.end());
   string parent_hash;
 
@@ -306,46 +371,33 @@ string agent::status_report() const {
   }
 
   // classifiers
-  ss << id << comma
-     << parent_hash << comma
-     << class_id << comma
-     << original_id << comma
-     << label << comma
-
-     // stats
-     << score_tmt.serialize(comma) << comma
-     << score_simple.serialize(comma) << comma
-     << score_refbot.serialize(comma) << comma
-     << rank << comma
-     << last_rank << comma
-     << age << comma
-     << mut_age << comma
+  row.i64(id).str(parent_hash).i64(class_id).i64(original_id).str(label);
 
-     // learning system parameters
-     << future_discount << comma
-     << w_reg << comma  // todo: regularization
-     << inspiration_age_limit << comma
-     << learning_rate << comma
-     << step_limit << comma
-     << use_f0c << comma
-
-     // training stats
-     << tstats.rel_change_mean << comma
-     << tstats.output_change << comma
-     << tstats.rate_successfull << comma
-     << tstats.rate_optim_failed << comma
-
-     // optimization stats
-     << optim_stats.success.serialize(comma) << comma
-     << optim_stats.improvement.serialize(comma) << comma
-     << optim_stats.its.serialize(comma) << comma
-     << optim_stats.overshoot.serialize(comma) << comma
-     << optim_stats.dx.serialize(comma) << comma
-     << optim_stats.dy.serialize(comma) << comma
-
-     << parents.size() << comma
-     << ancestors.size() << comma
-     << eval->status_report();
-
-  return ss.str();
+  // stats
+  append_dvalue(row, score_tmt);
+  append_dvalue(row, score_simple);
+  append_dvalue(row, score_refbot);
+  row.i64(rank).i64(last_rank).i64(age).i64(mut_age);
+
+  // learning system parameters
+  row.f64(future_discount)
+      .f64(w_reg)  // todo: regularization
+      .i64(inspiration_age_limit)
+      .f64(learning_rate)
+      .f64(step_limit)
+      .i64(use_f0c);
+
+  // training stats
+  row.f64(tstats.rel_change_mean).f64(tstats.output_change).f64(tstats.rate_successfull).f64(tstats.rate_optim_failed);
+
+  // optimization stats
+  append_dvalue(row, optim_stats.success);
+  append_dvalue(row, optim_stats.improvement);
+  append_dvalue(row, optim_stats.its);
+  append_dvalue(row, optim_stats.overshoot);
+  append_dvalue(row, optim_stats.dx);
+  append_dvalue(row, optim_stats.dy);
+
+  row.i64(parents.size()).i64(ancestors.size());
+  eval->status_report(row);
 }
\ No newline at end of file
@@ -75,10 +75,13 @@ class agent : public std::enable_shared_from_this<agent> {
 
   // constructors
   agent();
+  void assign_id();
   virtual void deserialize(std::stringstream &ss);
 
   // duplicators
   virtual agent_ptr clone() const = 0;
+  // copy to play another seat of the same team in one game, sharing the evaluator of this agent
+  virtual agent_ptr clone_seat() const = 0;
   virtual agent_ptr mate(agent_ptr p) const;
   virtual agent_ptr mutate() const;
 
@@ -89,8 +92,14 @@ class agent : public std::enable_shared_from_this<agent> {
 
   // analysis
   virtual record select_choice(game_ptr g);
+  // vectorized choice the agent picks, without keeping a record of the options
+  virtual vec decide(game_ptr g);
+  virtual record prepare_choice(game_ptr g);
+  virtual void evaluate_options(record &r);
+  virtual void finalize_choice(record &r);
   virtual double evaluate_choice(vec x) const;
   virtual bool evaluator_stability() const;
-  virtual std::string status_report() const;
+  // appends the stats columns of the run logs
+  virtual void status_report(log_row &row) const;
   virtual std::string serialize() const;
 };
@@ -6,14 +6,19 @@
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 #include <vector>
 
 #include "agent.hpp"
+#include "async_io.hpp"
 #include "game.hpp"
 #include "game_generator.hpp"
 #include "population_manager.hpp"
+#include "profiling.hpp"
+#include "trace.hpp"
 #include "random_tournament.hpp"
+#include "run_log.hpp"
 #include "tournament.hpp"
 #include "types.hpp"
 #include "utility.hpp"
@@ -35,44 +40,39 @@ struct test_vars {
   }
 };
 
-test_vars test_games(game_generator_ptr ggn, agent_ptr a, agent_ptr b) {
+// play ntest headless games per agent against the refbot, all agents in one parallel batch
+void run_tests(game_generator_ptr ggn, population_manager_ptr pm, double margin) {
   int ntest = 10;
-  test_vars res;
-  MutexType m;
+  cout << "Start running tests" << endl;
 
-  for (int j = 0; j < ntest; j++) {
-    game_ptr gr = ggn->generate_starting_state(ggn->make_teams({a, b}));
-    gr->play(1);
+  agent_ptr ref = pm->refbot;
+  if (!ref) ref = ggn->refbot_generator();
 
-    int pid = gr->team_clone_ids(a->team).front();
+  int n = pm->pop.size();
+  vector<test_vars> game_res(n * ntest);
 
-    m.Lock();
-    res.wins += a->team == gr->winner;
-    res.ties += gr->winner == -1;
-    res.speed += gr->score_simple(pid);
-    m.Unlock();
+#pragma omp parallel for schedule(dynamic)
+  for (int k = 0; k < game_res.size(); k++) {
+    agent_ptr a = pm->pop[k / ntest];
+    game_ptr gr = ggn->generate_starting_state(ggn->make_teams({a, ref}, true));
+    gr->play_headless(margin);
 
-    // ss << epoch << comma << "refbot" << comma << a->rank << comma << a->status_report() << comma << gr->end_stats() << endl;
+    int pid = gr->team_clone_ids(a->team).front();
+    game_res[k].wins = a->team == gr->winner;
+    game_res[k].ties = gr->winner == -1;
+    game_res[k].speed = gr->score_simple(pid);
   }
 
-  res.wins /= ntest;
-  res.ties /= ntest;
-  res.speed /= ntest;
-
-  return res;
-}
-
-void run_tests(game_generator_ptr ggn, population_manager_ptr pm) {
-  cout << "Start running tests" << endl;
-
-  agent_ptr ref = pm->refbot;
-  if (!ref) ref = ggn->refbot_generator();
+  for (int i = 0; i < n; i++) {
+    test_vars res;
+    for (int j = 0; j < ntest; j++) {
+      test_vars &x = game_res[i * ntest + j];
+      res.wins += x.wins / ntest;
+      res.ties += x.ties / ntest;
+      res.speed += x.speed / ntest;
+    }
 
-#pragma omp parallel for
-  for (int i = 0; i < pm->pop.size(); i++) {
     agent_ptr a = pm->pop[i];
-    test_vars res = test_games(ggn, a, ref);
-
     a->score_refbot.push(res.wins + 0.5 * res.ties);
     a->score_simple.push(res.speed);
   }
@@ -80,34 +80,48 @@ void run_tests(game_generator_ptr ggn, population_manager_ptr pm) {
   cout << "Completed running tests" << endl;
 }
 
-void write_stats(unsigned int run_id, unsigned int epoch, game_generator_ptr ggn, population_manager_ptr pop) {
+void write_stats(unsigned int run_id, unsigned int epoch, game_generator_ptr ggn, population_manager_ptr pop, run_log &pop_log) {
   pop->sortpop();
 
   // player stats
-  ofstream fstat("data/run-" + to_string(run_id) + "-population.csv", ios::app);
-  fstat << pop->pop_stats(to_string(epoch));
-  fstat.close();
+  pop_log.append(pop->pop_stats(log_row().i64(epoch)));
+  pop_log.flush();
 
+  // brain dumps are snapshots, so they are dropped rather than holding up the epoch when the I/O thread falls behind
   vector<agent_ptr> buf = pop->topn(3);
   for (int i = 0; i < 3; i++) {
     agent_ptr a = buf[i];
-    ofstream f("brains/run-" + to_string(run_id) + ".e" + to_string(epoch) + "p" + to_string(i));
-    f << serialize_agent(a);
-    f.close();
+    string fname = "brains/run-" + to_string(run_id) + ".e" + to_string(epoch) + "p" + to_string(i);
+    async_io::write(fname, serialize_agent(a), false, async_io::IO_DROP);
   }
 }
 
-void evolution(game_generator_ptr ggn, tournament_ptr trm, population_manager_ptr pop, int threads, string loadfile) {
+void write_profile(unsigned int run_id, unsigned int epoch, bool first_epoch) {
+  // only checked on the first epoch, as later rows may still be queued for writing
+  string fname = "data/run-" + to_string(run_id) + "-profile.csv";
+  bool new_file = first_epoch && !ifstream(fname).good();
+  async_io::write(fname, (new_file ? profiling::csv_header() : "") + profiling::epoch_row(epoch));
+}
+
+evolution_options::evolution_options() {
+  threads = 6;
+  test_margin = 0;
+  max_epochs = 0;
+  run_tests = true;
+  write_output = true;
+}
+
+void evolution(game_generator_ptr ggn, tournament_ptr trm, population_manager_ptr pop, evolution_options opts) {
 #ifndef DEBUG
-  omp_set_num_threads(threads);
+  omp_set_num_threads(opts.threads);
 #endif
 
   unsigned int start_epoch = 1;
   unsigned int run_id = rand_int(1, INT32_MAX);
   bool did_load = false;
 
-  if (loadfile.length() > 0) {
-    ifstream f(loadfile, ios::in);
+  if (opts.loadfile.length() > 0) {
+    ifstream f(opts.loadfile, ios::in);
     stringstream ss;
     ss << f.rdbuf();
 
@@ -117,24 +131,55 @@ void evolution(game_generator_ptr ggn, tournament_ptr trm, population_manager_pt
     cout << "Arena: loaded epoch " << start_epoch << endl;
   }
 
-  for (unsigned int epoch = start_epoch; true; epoch++) {
+  unique_ptr<run_log> pop_log;
+  if (opts.write_output) pop_log.reset(new run_log("data/run-" + to_string(run_id) + "-population.rlog", {"epoch", "rank"}));
+
+  for (unsigned int epoch = start_epoch; opts.max_epochs == 0 || epoch < start_epoch + opts.max_epochs; epoch++) {
     if (!did_load) {
       cout << "ARENA: RUN ID: " << run_id << ": starting epoch " << epoch << endl;
-      pop->prepare_epoch(epoch, ggn);
+      trace::set_epoch(epoch);
+      {
+        profiling::scoped_timer t(profiling::PP_PREPARE);
+        pop->prepare_epoch(epoch, ggn);
+      }
+
+      if (opts.run_tests) {
+        profiling::scoped_timer t(profiling::PP_TESTS);
+        run_tests(ggn, pop, opts.test_margin);
+      }
 
-      run_tests(ggn, pop);
       trm->run(pop, ggn, epoch);
-      run_tests(ggn, pop);
+
+      if (opts.run_tests) {
+        profiling::scoped_timer t(profiling::PP_TESTS);
+        run_tests(ggn, pop, opts.test_margin);
+      }
 
       cout << "Arena: epoch " << epoch << ": completed game rounds, generating epoch stats" << endl;
-      write_stats(run_id, epoch, ggn, pop);
+      if (opts.write_output) {
+        profiling::scoped_timer t(profiling::PP_STATS);
+        write_stats(run_id, epoch, ggn, pop, *pop_log);
+      }
       cout << "Done" << endl;
     }
 
+    // migrants arrive before evolve, so they are ranked against residents scored in this epoch rather than evicted
+    // in favour of unscored children
+    if (opts.epoch_hook) opts.epoch_hook(epoch, pop);
+
     // train on all games and update player scores
     cout << "Start mating and mutating" << endl;
-    pop->evolve(ggn);
+    {
+      profiling::scoped_timer t(profiling::PP_EVOLVE);
+      pop->evolve(ggn);
+    }
     cout << "Mating and mutation done" << endl;
+
+    if (opts.write_output) {
+      write_profile(run_id, epoch, epoch == start_epoch);
+      trace::flush();
+      cout << "Arena: " << async_io::status() << endl;
+    }
     did_load = false;
   }
 }
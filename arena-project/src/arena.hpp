@@ -1,7 +1,22 @@
 #pragma once
 
+#include <functional>
 #include <string>
 
 #include "types.hpp"
 
-void evolution(game_generator_ptr gg, tournament_ptr t, population_manager_ptr p, int threads, std::string loadfile = "");
+// run configuration for evolution, max_epochs = 0 runs until interrupted.
+// epoch_hook is called every epoch after the games and stats, before evolve.
+struct evolution_options {
+  int threads;
+  std::string loadfile;
+  double test_margin;
+  int max_epochs;
+  bool run_tests;
+  bool write_output;
+  std::function<void(unsigned int, population_manager_ptr)> epoch_hook;
+
+  evolution_options();
+};
+
+void evolution(game_generator_ptr gg, tournament_ptr t, population_manager_ptr p, evolution_options opts);
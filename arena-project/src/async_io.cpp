@@ -0,0 +1,206 @@
+#include "async_io.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+namespace async_io {
+struct job {
+  string path;
+  string data;
+  bool append;
+};
+
+// Bounded multi producer queue after Vyukov: each slot has a sequence number telling whether it is free for the
+// producer at ticket pos (seq == pos) or holds the job of ticket pos for the consumer (seq == pos + 1)
+const size_t capacity = 256;
+
+struct slot {
+  atomic<size_t> seq;
+  job j;
+};
+
+slot slots[capacity];
+atomic<size_t> head(0), tail(0);
+
+bool try_push(job &j) {
+  size_t pos = tail.load(memory_order_relaxed);
+  slot *s;
+  while (true) {
+    s = &slots[pos % capacity];
+    const intptr_t diff = (intptr_t)s->seq.load(memory_order_acquire) - (intptr_t)pos;
+    if (diff == 0) {
+      if (tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = tail.load(memory_order_relaxed);
+    }
+  }
+
+  s->j = move(j);
+  s->seq.store(pos + 1, memory_order_release);
+  return true;
+}
+
+bool try_pop(job &j) {
+  size_t pos = head.load(memory_order_relaxed);
+  slot *s;
+  while (true) {
+    s = &slots[pos % capacity];
+    const intptr_t diff = (intptr_t)s->seq.load(memory_order_acquire) - (intptr_t)(pos + 1);
+    if (diff == 0) {
+      if (head.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = head.load(memory_order_relaxed);
+    }
+  }
+
+  j = move(s->j);
+  s->seq.store(pos + capacity, memory_order_release);
+  return true;
+}
+
+atomic<long> max_depth(0), written(0), bytes(0), blocked(0), dropped(0), failed(0);
+
+// buffers handed to write and not yet written, for drain
+atomic<long> pending(0);
+
+// the I/O thread sleeps on wake when the queue is empty, writers only take the lock to wake it
+mutex wake_lock;
+condition_variable wake, done;
+atomic<bool> sleeping(false);
+
+struct io_thread {
+  thread t;
+  atomic<bool> stop;
+
+  io_thread() : stop(false) {
+    for (size_t i = 0; i < capacity; i++) slots[i].seq.store(i, memory_order_relaxed);
+    t = thread(&io_thread::run, this);
+  }
+
+  // write what is left at exit
+  ~io_thread() {
+    stop = true;
+    {
+      lock_guard<mutex> guard(wake_lock);
+      wake.notify_one();
+    }
+    t.join();
+  }
+
+  void run() {
+    map<string, ofstream> files;
+    job j;
+
+    while (true) {
+      if (try_pop(j)) {
+        write_job(files, j);
+        pending--;
+        continue;
+      }
+
+      unique_lock<mutex> guard(wake_lock);
+      done.notify_all();
+      if (stop) break;
+      sleeping = true;
+      wake.wait_for(guard, chrono::milliseconds(100), []() { return head.load() != tail.load(); });
+      sleeping = false;
+    }
+  }
+
+  void write_job(map<string, ofstream> &files, job &j) {
+    // appended files stay open, files that are replaced are written and closed
+    if (files.size() >= 64) files.clear();
+    if (!j.append) files.erase(j.path);
+    auto it = files.find(j.path);
+    if (it == files.end()) {
+      it = files.emplace(j.path, ofstream(j.path, ios::binary | (j.append ? ios::app : ios::trunc))).first;
+    }
+
+    ofstream &f = it->second;
+    f.write(j.data.data(), j.data.size());
+    f.flush();
+
+    if (f) {
+      written++;
+      bytes += j.data.size();
+    } else if (failed++ == 0) {
+      cerr << "async_io: failed to write " << j.path << endl;
+    }
+    if (!f || !j.append) files.erase(it);
+  }
+};
+
+io_thread &writer() {
+  static io_thread t;
+  return t;
+}
+
+bool write(string path, string data, bool append, overflow policy) {
+  writer();
+  job j = {move(path), move(data), append};
+
+  pending++;
+  if (!try_push(j)) {
+    if (policy == IO_DROP) {
+      pending--;
+      dropped++;
+      return false;
+    }
+
+    blocked++;
+    while (!try_push(j)) this_thread::sleep_for(chrono::microseconds(100));
+  }
+
+  long depth = tail.load() - head.load(), m = max_depth.load();
+  while (depth > m && !max_depth.compare_exchange_weak(m, depth)) {
+  }
+
+  atomic_thread_fence(memory_order_seq_cst);
+  if (sleeping) {
+    lock_guard<mutex> guard(wake_lock);
+    wake.notify_one();
+  }
+  return true;
+}
+
+void drain() {
+  unique_lock<mutex> guard(wake_lock);
+  while (pending > 0) {
+    wake.notify_one();
+    done.wait_for(guard, chrono::milliseconds(10));
+  }
+}
+
+counters stats() {
+  counters c;
+  c.depth = tail.load() - head.load();
+  c.max_depth = max_depth;
+  c.written = written;
+  c.bytes = bytes;
+  c.blocked = blocked;
+  c.dropped = dropped;
+  c.failed = failed;
+  return c;
+}
+
+string status() {
+  counters c = stats();
+  stringstream ss;
+  ss << "io queue " << c.depth << "/" << capacity << " (max " << c.max_depth << "), " << c.written << " buffers "
+     << c.bytes << " bytes written, " << c.blocked << " blocked, " << c.dropped << " dropped, " << c.failed << " failed";
+  return ss.str();
+}
+};  // namespace async_io
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+// Background file writes. Callers serialize their data and hand the buffer over through a bounded lock-free queue,
+// a single I/O thread (started on the first write) writes the buffers in queue order, so the writes of one thread to
+// one file stay in order.
+namespace async_io {
+// what write does when the queue is full
+enum overflow {
+  IO_BLOCK,  // wait for the I/O thread to make room, counted in blocked
+  IO_DROP    // discard the buffer, counted in dropped
+};
+
+struct counters {
+  long depth;      // buffers waiting in the queue
+  long max_depth;  // since start
+  long written;    // buffers written
+  long bytes;      // bytes written
+  long blocked;    // writes that had to wait for room in the queue
+  long dropped;    // buffers discarded because the queue was full
+  long failed;     // buffers that could not be written
+};
+
+// queue data to be appended to path, or to replace its content. Returns false if the buffer was dropped.
+bool write(std::string path, std::string data, bool append = true, overflow policy = IO_BLOCK);
+
+// wait until all queued buffers are written
+void drain();
+
+counters stats();
+// one line summary of the counters
+std::string status();
+};  // namespace async_io
@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "agent.hpp"
+#include "evaluator.hpp"
+#include "game.hpp"
+#include "pod_agent.hpp"
+#include "pod_game.hpp"
+#include "pod_game_generator.hpp"
+#include "simple_pod_evaluator.hpp"
+#include "team_evaluator.hpp"
+#include "tree_evaluator.hpp"
+#include "utility.hpp"
+
+using namespace std;
+
+// Microbenchmarks for evaluation, game step and training kernels.
+//
+// Usage: bench [seed <n>] [time <seconds>] [corpus <dir>] [out <file>]
+//        bench generate [seed <n>] [corpus <dir>]
+//
+// Trees of three sizes are loaded from the corpus dir (committed in
+// corpus/), records and game states are generated from the seed. Results are
+// written as json.
+
+struct bench_result {
+  string name;
+  double param;
+  long iterations;
+  double ns_per_op;
+};
+
+const vector<string> tree_sizes = {"s", "m", "l"};
+
+agent_ptr refbot_gen() {
+  agent_ptr a(new pod_agent);
+  a->eval = evaluator_ptr(new simple_pod_evaluator);
+  a->label = "simple-pod";
+  return a;
+}
+
+evaluator_ptr tree_gen(input_sampler isam, int cdim, set<int> ireq) {
+  evaluator_ptr e(new tree_evaluator);
+  e->initialize(isam, cdim, ireq);
+  return e;
+}
+
+// pod agent with the same tree for all roles
+agent_ptr tree_agent(evaluator_ptr e, int ppt) {
+  agent_ptr a(new pod_agent);
+  vector<evaluator_ptr> evals;
+  for (int j = 0; j < ppt; j++) evals.push_back(e->clone());
+  a->eval = team_evaluator::ptr(new team_evaluator(evals, 4));
+  a->label = "tree-pod";
+  return a;
+}
+
+string corpus_file(string dir, string size) {
+  return dir + "/tree-" + size + ".eval";
+}
+
+// run f repeatedly for at least min_time seconds, with output from the kernels silenced
+bench_result run_bench(string name, double param, double min_time, function<void()> f) {
+  ofstream null_stream;
+  streambuf *cout_buf = cout.rdbuf(null_stream.rdbuf());
+
+  f();
+
+  long its = 0;
+  double elapsed = 0;
+  auto t0 = chrono::steady_clock::now();
+  while (elapsed < min_time) {
+    f();
+    its++;
+    elapsed = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+  }
+
+  cout.rdbuf(cout_buf);
+  cerr << name << ": " << 1e9 * elapsed / its << " ns/op" << endl;
+
+  return {name, param, its, 1e9 * elapsed / its};
+}
+
+// store the smallest, median and largest of a set of generated trees
+void generate_corpus(string dir, input_sampler isam, int cdim, set<int> ireq) {
+  vector<evaluator_ptr> buf;
+  for (int i = 0; i < 100; i++) buf.push_back(tree_gen(isam, cdim, ireq));
+  sort(buf.begin(), buf.end(), [](evaluator_ptr a, evaluator_ptr b) { return a->complexity() < b->complexity(); });
+
+  vector<evaluator_ptr> pick = {buf.front(), buf[buf.size() / 2], buf.back()};
+  for (int k = 0; k < tree_sizes.size(); k++) {
+    ofstream f(corpus_file(dir, tree_sizes[k]));
+    f << serialize_evaluator(pick[k]);
+    f.close();
+    cerr << "bench: wrote " << corpus_file(dir, tree_sizes[k]) << " with complexity " << pick[k]->complexity() << endl;
+  }
+}
+
+evaluator_ptr load_tree(string fname) {
+  ifstream f(fname);
+  if (!f) throw runtime_error("bench: missing corpus file " + fname + ", run bench generate");
+  stringstream ss;
+  ss << f.rdbuf();
+  return deserialize_evaluator(ss);
+}
+
+string to_json(const vector<bench_result> &res, unsigned int seed, double min_time) {
+  stringstream ss;
+  ss << "{" << endl
+     << "  \"seed\": " << seed << "," << endl
+     << "  \"min_time\": " << min_time << "," << endl
+     << "  \"benchmarks\": [" << endl;
+
+  for (int i = 0; i < res.size(); i++) {
+    ss << "    {\"name\": \"" << res[i].name << "\", "
+       << "\"param\": " << res[i].param << ", "
+       << "\"iterations\": " << res[i].iterations << ", "
+       << "\"ns_per_op\": " << res[i].ns_per_op << "}"
+       << (i < res.size() - 1 ? "," : "") << endl;
+  }
+
+  ss << "  ]" << endl
+     << "}" << endl;
+  return ss.str();
+}
+
+int main(int argc, char **argv) {
+  unsigned int seed = 1;
+  double min_time = 0.5;
+  string corpus = "corpus";
+  string outfile;
+  bool generate = false;
+  int ppt = 2;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "seed")) {
+      seed = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "time")) {
+      min_time = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "corpus")) {
+      corpus = argv[++i];
+    } else if (!strcmp(argv[i], "out")) {
+      outfile = argv[++i];
+    } else if (!strcmp(argv[i], "generate")) {
+      generate = true;
+    }
+  }
+
+  omp_set_num_threads(1);
+  seed_random_engine(seed);
+
+  ofstream null_stream;
+  streambuf *cout_buf = cout.rdbuf(null_stream.rdbuf());
+  pod_game_generator ggen(2, ppt, refbot_gen);
+  input_sampler isam = ggen.generate_input_sampler();
+  int cdim = ggen.choice_dim();
+  set<int> ireq = ggen.required_inputs();
+  cout.rdbuf(cout_buf);
+
+  if (generate) {
+    generate_corpus(corpus, isam, cdim, ireq);
+    return 0;
+  }
+
+  vector<tree_evaluator::ptr> trees;
+  for (auto s : tree_sizes) trees.push_back(static_pointer_cast<tree_evaluator>(load_tree(corpus_file(corpus, s))));
+
+  // fixed records from seeded refbot games
+  vector<record> records;
+  cout.rdbuf(null_stream.rdbuf());
+  while (records.size() < 200) {
+    game_ptr g = ggen.team_bots_vs(refbot_gen());
+    for (auto x : g->play(1)) records = vec_append(records, x.second);
+  }
+  cout.rdbuf(cout_buf);
+  records.resize(200);
+
+  vector<const vec *> inputs;
+  for (auto &r : records) {
+    for (auto &o : r.opts) inputs.push_back(&o.input);
+  }
+
+  vector<bench_result> res;
+
+  for (int k = 0; k < trees.size(); k++) {
+    tree_evaluator::ptr e = trees[k];
+    double c = e->complexity();
+    int idx = 0;
+
+    res.push_back(run_bench("tree_evaluate/" + tree_sizes[k], c, min_time, [&]() {
+      e->evaluate(*inputs[idx++ % inputs.size()]);
+    }));
+
+    res.push_back(run_bench("tree_evaluate_batch/" + tree_sizes[k], c, min_time, [&]() {
+      record &r = records[idx++ % records.size()];
+      vector<const vec *> x(r.opts.size());
+      vec y(r.opts.size());
+      for (int i = 0; i < x.size(); i++) x[i] = &r.opts[i].input;
+      e->evaluate_batch(x, y.data());
+    }));
+
+    res.push_back(run_bench("tree_gradient/" + tree_sizes[k], c, min_time, [&]() {
+      const vec &x = *inputs[idx++ % inputs.size()];
+      e->gradient(x, 1);
+    }));
+
+    res.push_back(run_bench("serialize_roundtrip/" + tree_sizes[k], c, min_time, [&]() {
+      stringstream ss(serialize_evaluator(e));
+      deserialize_evaluator(ss);
+    }));
+  }
+
+  agent_ptr a = tree_agent(trees[1], ppt);
+  vector<record> train_set(records.begin(), records.begin() + 20);
+
+  res.push_back(run_bench("mod_update", trees[1]->complexity(), min_time, [&]() {
+    double rel_change;
+    trees[1]->clone()->mod_update(train_set, a, rel_change);
+  }));
+
+  res.push_back(run_bench("serialize_agent_roundtrip", a->eval->complexity(), min_time, [&]() {
+    stringstream ss(serialize_agent(a));
+    deserialize_agent(ss);
+  }));
+
+  // one game played over from its starting state, so no game is generated in the timed loop
+  shared_ptr<pod_game> g = static_pointer_cast<pod_game>(ggen.team_bots_vs(refbot_gen()));
+  int pid = g->players.begin()->first;
+  pod_replay start;
+  g->start_replay(&start);
+  g->replay = 0;
+
+  res.push_back(run_bench("pod_game_increment", g->players.size(), min_time, [&]() {
+    if (!g->turns_remaining()) {
+      g->setup_from_replay(start);
+    }
+    g->increment();
+    g->turns_played++;
+  }));
+
+  res.push_back(run_bench("vectorize_state", g->players.size(), min_time, [&]() {
+    g->vectorize_state(pid);
+  }));
+
+  game_ptr gt = ggen.team_bots_vs(a);
+  agent_ptr p = gt->players.at(gt->team_clone_ids(0).front());
+
+  res.push_back(run_bench("select_choice", a->eval->complexity(), min_time, [&]() {
+    p->select_choice(gt);
+  }));
+
+  string json = to_json(res, seed, min_time);
+  if (outfile.length()) {
+    ofstream f(outfile);
+    f << json;
+    f.close();
+  } else {
+    cout << json;
+  }
+
+  return 0;
+}
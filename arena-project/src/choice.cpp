@@ -1,6 +1,7 @@
 #include "choice.hpp"
 
-#include <algorithm>
+#include <cassert>
+#include <cmath>
 
 #include "agent.hpp"
 #include "game.hpp"
@@ -10,21 +11,60 @@ using namespace std;
 
 choice_selector::choice_selector(float r, cs_schema s) : xrate(r), schema(s){};
 
-int choice_selector::select(vector<option> opts) {
-  if (u01() < xrate) return rand_int(0, opts.size() - 1);
+template <typename F>
+int choice_selector::select_impl(F score, int n) const {
+  assert(n > 0);
 
-  for (int i = 0; i < opts.size(); i++) opts[i].original_idx = i;
+  if (schema == CS_WEIGHTED && xrate > 0) {
+    // single pass softmax sample: keep a running max and a sum of weights
+    // relative to it, and replace the candidate with probability w / sum
+    int res = 0;
+    scalar m = score(0);
+    double sum = 1;
+    for (int i = 1; i < n; i++) {
+      scalar x = score(i);
+      double w;
+      if (x > m) {
+        sum *= exp((m - x) / xrate);
+        m = x;
+        w = 1;
+      } else {
+        w = exp((x - m) / xrate);
+      }
+      sum += w;
+      if (u01() * sum < w) res = i;
+    }
+    return res;
+  }
 
-  // todo: support for weighted selection
-  // sort options
-  sort(opts.begin(), opts.end(), [](option a, option b) {
-    return a.output > b.output;
-  });
+  int res = explore(n);
+  if (res >= 0) return res;
 
-  // chose an option with exponential probability per rank
-  int rank = ranked_sample(seq(0, opts.size() - 1), 1 - xrate);
+  res = 0;
+  for (int i = 1; i < n; i++) {
+    if (score(i) > score(res)) res = i;
+  }
+  return res;
+}
+
+int choice_selector::explore(int n) const {
+  return u01() < xrate ? rand_int(0, n - 1) : -1;
+}
+
+int choice_selector::best(const scalar *scores, int n) const {
+  int res = 0;
+  for (int i = 1; i < n; i++) {
+    if (scores[i] > scores[res]) res = i;
+  }
+  return res;
+}
+
+int choice_selector::select(const scalar *scores, int n) const {
+  return select_impl([scores](int i) { return scores[i]; }, n);
+}
 
-  return opts[0].original_idx;
+int choice_selector::select(const vector<option> &opts) const {
+  return select_impl([&opts](int i) { return opts[i].output; }, opts.size());
 }
 
 void choice_selector::set_exploration_rate(float r) { xrate = r; }
@@ -17,17 +17,29 @@ enum cs_schema {
   CS_WEIGHTED
 };
 
+// CS_RANKED: best option, uniformly random option with probability xrate
+// CS_WEIGHTED: softmax over option outputs with temperature xrate
 struct choice_selector {
   float xrate;
   cs_schema schema;
 
  public:
   choice_selector(float r, cs_schema s = CS_RANKED);
-  int select(std::vector<option> opts);
+  int select(const scalar *scores, int n) const;
+  int select(const std::vector<option> &opts) const;
+  // the two steps of CS_RANKED, for callers that find the best option without scoring them all:
+  // a uniformly random option with probability xrate, otherwise -1
+  int explore(int n) const;
+  // first option with the highest score
+  int best(const scalar *scores, int n) const;
   void set_exploration_rate(float r);
   void set_schema(cs_schema s);
   std::string serialize() const;
   void deserialize(std::stringstream &ss);
+
+ private:
+  template <typename F>
+  int select_impl(F score, int n) const;
 };
 
 // typedef std::function<vec(game::ptr g, int pid, choice::ptr c)> vectorizer;
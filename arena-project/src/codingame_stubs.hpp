@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// No-op stand-ins for profiling.hpp, trace.hpp and run_log.hpp in the single file codingame bundle made by
+// bin/build_codingame.sh, which leaves out their sources.
+namespace profiling {
+enum counter {
+  PC_GAMES,
+  PC_TURNS,
+  PC_DECISIONS,
+  PC_EVALUATIONS,
+  PC_GRADIENTS,
+  PC_ALLOCATIONS,
+  PC_OPTIM_STEPS,
+  PC_SAMPLES,
+  PC_NUM
+};
+
+enum phase {
+  PP_PREPARE,
+  PP_TESTS,
+  PP_PLAY,
+  PP_TRAIN,
+  PP_STATS,
+  PP_EVOLVE,
+  PP_NUM
+};
+
+inline void count(counter c, long n = 1) {}
+inline void add_time(phase p, double seconds) {}
+
+struct scoped_timer {
+  scoped_timer(phase p) {}
+};
+};  // namespace profiling
+
+#define TRACE_SPAN(...)
+#define TRACE_SPAN_NAMED(var, ...)
+#define TRACE_SET_AGENT(var, id)
+
+class log_row {
+ public:
+  log_row &i64(int64_t x) { return *this; }
+  log_row &f64(double x) { return *this; }
+  log_row &str(std::string x) { return *this; }
+  log_row &csv(const std::string &text) { return *this; }
+};
+
+class run_log {
+ public:
+  void append(log_row row) {}
+  void append(std::vector<log_row> rows) {}
+  void append_csv(const std::string &rows) {}
+};
@@ -5,6 +5,8 @@
 #include <sstream>
 
 #include "agent.hpp"
+#include "profiling.hpp"
+#include "rbf_evaluator.hpp"
 #include "team_evaluator.hpp"
 #include "tree_evaluator.hpp"
 #include "types.hpp"
@@ -30,6 +32,23 @@ void evaluator::deserialize(stringstream &ss) {
   mut_tag = (dist_category)buf;
 }
 
+float evaluator::evaluate_float(const fvec &x) {
+  return evaluate(type_shift<float, scalar>(x));
+}
+
+double evaluator::evaluate_double(const dvec &x) {
+  return evaluate(type_shift<double, scalar>(x));
+}
+
+// evaluate one output per input row, evaluators that can share work across rows override this
+void evaluator::evaluate_batch(const vector<const vec *> &inputs, scalar *outputs) {
+  for (int i = 0; i < inputs.size(); i++) outputs[i] = evaluate(*inputs[i]);
+}
+
+bool evaluator::best_choice(const vec &state, vec &choice) {
+  return false;
+}
+
 evaluator_ptr deserialize_evaluator(stringstream &ss) {
   evaluator_ptr eval;
   string tag;
@@ -39,6 +58,8 @@ evaluator_ptr deserialize_evaluator(stringstream &ss) {
     eval = evaluator_ptr(new tree_evaluator);
   } else if (tag == "team") {
     eval = evaluator_ptr(new team_evaluator);
+  } else if (tag == "rbf") {
+    eval = evaluator_ptr(new rbf_evaluator);
   } else {
     throw runtime_error("Invalid evaluator tag: " + tag);
   }
@@ -88,13 +109,14 @@ optim_result<double> evaluator::run_nlopt(vector<record> results, agent_ptr a, d
   rel_change = 0;
   int n = results.size();
 
-  vec x = get_weights();
+  // nlopt works in double precision regardless of the scalar type
+  dvec x = type_shift<scalar, double>(get_weights());
   int dim = x.size();
 
   evaluator_ptr buf = clone();
 
   auto fopt = [this, results, a, buf](const std::vector<double> &x) -> double {
-    buf->set_weights(x);
+    buf->set_weights(type_shift<double, scalar>(x));
     // Compute opt value
     double G = 0;
     for (auto res : results) {
@@ -116,7 +138,7 @@ optim_result<double> evaluator::run_nlopt(vector<record> results, agent_ptr a, d
       throw logic_error("Bad gradient dim");
     }
 
-    buf->set_weights(x);
+    buf->set_weights(type_shift<double, scalar>(x));
     // Compute gradient
     int n = x.size();
     vec dgdw(n, 0);
@@ -126,6 +148,7 @@ optim_result<double> evaluator::run_nlopt(vector<record> results, agent_ptr a, d
       // dG/dwj = sum(dGi/dwj)
       for (int i = 0; i < res.opts.size(); i++) {
         dgdw = dgdw + buf->gradient(res.opts[i].input, res.opts[i].output);
+        profiling::count(profiling::PC_GRADIENTS);
       }
     }
 
@@ -133,10 +156,15 @@ optim_result<double> evaluator::run_nlopt(vector<record> results, agent_ptr a, d
     for (int i = 0; i < n; i++) grad[i] = dgdw[i] + a->w_reg * signum(x[i]);
 
     // scale down grad so nlopt will chill a bit
-    double gn = l2norm(grad);
-    if (gn > 0.01 * n) grad = 0.01 * n / gn * grad;
+    double gn = 0;
+    for (auto g : grad) gn += g * g;
+    gn = sqrt(gn);
+    if (gn > 0.01 * n) {
+      for (auto &g : grad) g *= 0.01 * n / gn;
+    }
 
     // Return opt value
+    profiling::count(profiling::PC_OPTIM_STEPS);
     double y = fopt(x);
     cout << "New objective: " << y << " at " << x << endl;
     cout << " -- gradient " << grad << endl;
@@ -147,21 +175,21 @@ optim_result<double> evaluator::run_nlopt(vector<record> results, agent_ptr a, d
   nlopt::opt opt(nlopt::LD_LBFGS, dim);
   opt.set_min_objective(nlopt_f, &f);
   opt.set_maxeval(20);
-  opt.set_lower_bounds(vec(dim, -10));
-  opt.set_upper_bounds(vec(dim, 10));
+  opt.set_lower_bounds(dvec(dim, -10));
+  opt.set_upper_bounds(dvec(dim, 10));
   double minf;
   double y = fopt(x);
-  vec x0 = x;
+  dvec x0 = x;
 
   optim_result<double> res;
   try {
     nlopt::result result = opt.optimize(x, minf);
     cout << "found minimum " << minf << endl;
-    set_weights(x);
+    set_weights(type_shift<double, scalar>(x));
     res.success = true;
     res.obj = minf;
     res.improvement = (y - minf) / y;
-    cout << "change x: " << l2norm(x - x0) << endl;
+    cout << "change x: " << l2norm(type_shift<double, scalar>(x) - type_shift<double, scalar>(x0)) << endl;
     cout << "change y: from " << y << " to " << minf << endl;
   } catch (std::exception &e) {
     cout << "nlopt failed: " << e.what() << endl;
@@ -184,6 +212,7 @@ vec evaluator::fgrad(vec x, vector<record> results, agent_ptr a) {
     // dG/dwj = sum(dGi/dwj)
     for (int i = 0; i < res.opts.size(); i++) {
       dgdw = dgdw + buf->gradient(res.opts[i].input, res.opts[i].output);
+      profiling::count(profiling::PC_GRADIENTS);
     }
   }
 
@@ -220,7 +249,7 @@ optim_result<double> evaluator::mod_update(vector<record> results, agent_ptr a,
   vec x = get_weights();
   double y = fopt(x);
   vec g = fgrad(x, results, a);
-  if (a->use_f0c) g = map<double, double>(bind(f0c, y, placeholders::_1), g);
+  if (a->use_f0c) g = map<scalar, scalar>(bind(f0c, y, placeholders::_1), g);
   vec delta = -1 * g;
   rel_change = l2norm(delta) / l2norm(x);
 
@@ -231,6 +260,7 @@ optim_result<double> evaluator::mod_update(vector<record> results, agent_ptr a,
 
   double y2 = fopt(x + delta);
   stable = stable && isfinite(y2);
+  profiling::count(profiling::PC_OPTIM_STEPS);
 
   optim_result<double> res;
 
@@ -32,14 +32,20 @@ class evaluator {
   virtual evaluator_ptr update(std::vector<record> records, agent_ptr a, double &rel_change) const;
   virtual void reset_memory_weights(double a);
 
-  virtual double evaluate(vec x) = 0;
+  virtual scalar evaluate(vec x) = 0;
+  virtual float evaluate_float(const fvec &x);     // evaluate in single precision regardless of build scalar
+  virtual double evaluate_double(const dvec &x);   // evaluate in double precision regardless of build scalar
+  virtual void evaluate_batch(const std::vector<const vec *> &inputs, scalar *outputs);
+  // vectorized choice with the highest output among the options of a decision, computed from the state alone by
+  // evaluators with a closed form policy; false if the options have to be scored
+  virtual bool best_choice(const vec &state, vec &choice);
   virtual void prune(double limit = 0) = 0;
   virtual evaluator_ptr mate(evaluator_ptr partner) const = 0;
   virtual evaluator_ptr mutate(dist_category dc = MUT_RANDOM) const = 0;
   virtual std::string serialize() const;
   virtual void deserialize(std::stringstream &ss);
   virtual void initialize(input_sampler sampler, int cdim, std::set<int> ireq) = 0;
-  virtual std::string status_report() const = 0;
+  virtual void status_report(log_row &row) const = 0;
   virtual evaluator_ptr clone() const = 0;
   virtual double complexity() const = 0;
   virtual std::set<int> list_inputs() const = 0;
@@ -48,7 +54,7 @@ class evaluator {
  protected:
   virtual void set_weights(const vec &x) = 0;
   virtual vec get_weights() const = 0;
-  virtual vec gradient(vec input, double target) const = 0;
+  virtual vec gradient(vec input, scalar target) const = 0;
 };
 
 evaluator_ptr deserialize_evaluator(std::stringstream &ss);
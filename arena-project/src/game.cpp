@@ -7,6 +7,8 @@
 #include <vector>
 
 #include "agent.hpp"
+#include "profiling.hpp"
+#include "trace.hpp"
 #include "types.hpp"
 #include "utility.hpp"
 
@@ -28,23 +30,60 @@ void game::initialize() {
   turns_played = 0;
 }
 
-hm<int, vector<record>> game::play(int epoch, string row_prefix) {
+hm<int, vector<record>> game::play(int epoch, const log_row &row_prefix) {
+  TRACE_SPAN("game", original_agents.empty() ? -1 : original_agents.front()->id, game_id);
   hm<int, vector<record>> res;
 
-  for (turns_played = 0; turns_played < max_turns && !finished(); turns_played++) {
+  for (turns_played = 0; turns_remaining(); turns_played++) {
     record_table rect = increment(row_prefix);
     for (auto x : rect) res[x.first].push_back(x.second);
   }
 
-  // add reward for winning team
+  add_winner_reward(res, epoch);
+  profiling::count(profiling::PC_GAMES);
+
+  return res;
+}
+
+// play without collecting records, stopping early when the outcome is decided
+void game::play_headless(double margin) {
+  TRACE_SPAN("test_game", -1, game_id);
+  for (turns_played = 0; turns_remaining(); turns_played++) {
+    if (margin > 0 && outcome_decided(margin)) {
+      select_winner();
+      break;
+    }
+    step();
+  }
+  profiling::count(profiling::PC_GAMES);
+}
+
+bool game::outcome_decided(double margin) {
+  return false;
+}
+
+void game::step() {
+  increment();
+}
+
+record_table game::prepare_turn() {
+  record_table res;
+  for (auto x : players) res[x.first] = x.second->prepare_choice(shared_from_this());
+  return res;
+}
+
+bool game::turns_remaining() {
+  return turns_played < max_turns && !finished();
+}
+
+// add reward for winning team
+void game::add_winner_reward(hm<int, vector<record>> &res, int epoch) {
   if (winner > -1) {
     float reward = winner_reward(epoch);
     for (auto x : players) {
-      if (x.second->team == winner) res[x.first].back().reward += reward;
+      if (x.second->team == winner && res[x.first].size()) res[x.first].back().reward += reward;
     }
   }
-
-  return res;
 }
 
 void game::reset() {
@@ -1,15 +1,17 @@
 #pragma once
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "run_log.hpp"
 #include "types.hpp"
 
-class game {
+class game : public std::enable_shared_from_this<game> {
  public:
   int game_id;
-  std::fstream *enable_output;
+  run_log *enable_output;
   int winner;
   int turns_played;
   int max_turns;
@@ -23,8 +25,16 @@ class game {
 
   virtual void setup_from_input(std::istream &s) = 0;
   virtual double winner_reward(int epoch) = 0;
-  virtual record_table increment(std::string row_prefix = "") = 0;
+  // one turn with each player deciding in turn on the state left by the players before it
+  virtual record_table increment(const log_row &row_prefix = log_row()) = 0;
+  // split turn for drivers that evaluate the options of many games together: all players decide on the same state,
+  // then the choices are applied together
+  virtual record_table prepare_turn();
+  // one turn as increment plays it, without building records or rewards
+  virtual void step();
+  virtual record_table apply_turn(record_table decisions, const log_row &row_prefix = log_row()) = 0;
   virtual bool finished() = 0;
+  virtual bool outcome_decided(double margin);
   virtual std::string end_stats() = 0;
   virtual int select_winner() = 0;
   virtual double score_simple(int pid) = 0;
@@ -33,7 +43,10 @@ class game {
   virtual vec vectorize_state(int pid) const = 0;
   virtual choice_ptr unvectorize_choice(vec x) const = 0;
 
-  hm<int, std::vector<record>> play(int epoch, std::string row_prefix = "");
+  hm<int, std::vector<record>> play(int epoch, const log_row &row_prefix = log_row());
+  void play_headless(double margin = 0);
+  bool turns_remaining();
+  void add_winner_reward(hm<int, std::vector<record>> &res, int epoch);
   choice_ptr select_choice(agent_ptr a);
   std::vector<int> team_clone_ids(int tid) const;
   vec vectorize_input(choice_ptr c, int pid) const;
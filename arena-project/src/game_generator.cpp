@@ -9,6 +9,7 @@
 
 #include "agent.hpp"
 #include "game.hpp"
+#include "trace.hpp"
 #include "tree_evaluator.hpp"
 #include "utility.hpp"
 
@@ -20,7 +21,7 @@ game_generator::game_generator(int teams, int ppt, agent_f refbot_generator) : n
   max_complexity = 800;
 }
 
-vector<agent_ptr> game_generator::make_teams(vector<agent_ptr> ps) const {
+vector<agent_ptr> game_generator::make_teams(vector<agent_ptr> ps, bool shared_seats) const {
   vector<agent_ptr> buf(nr_of_teams * ppt);
   set<int> pids;
 
@@ -28,7 +29,7 @@ vector<agent_ptr> game_generator::make_teams(vector<agent_ptr> ps) const {
     agent_ptr b = ps[tid];
     b->team = tid;
     for (int k = 0; k < ppt; k++) {
-      agent_ptr a = b->clone();
+      agent_ptr a = k && shared_seats ? buf[tid * ppt]->clone_seat() : b->clone();
       a->team = tid;
       a->team_index = k;
       buf[tid * ppt + k] = a;
@@ -100,6 +101,7 @@ agent_ptr game_generator::prepared_player(input_sampler isam, agent_f gen, float
 
     // #pragma omp parallel for
     //   for (int t = 0; t < prep_npar; t++) {
+    TRACE_SPAN_NAMED(prep_span, "prepare_candidate");
     float eval = 0;
     agent_ptr a = vgen();
     int restarts = 0;
@@ -154,6 +156,8 @@ agent_ptr game_generator::prepared_player(input_sampler isam, agent_f gen, float
       }
     }
 
+    TRACE_SET_AGENT(prep_span, a->id);
+
     if (eval > plim) {
       a->score_simple.push(eval);
       cout << "prepared_player (" << restarts << " restarts): ACCEPTING " << a->id << " with complexity " << a->eval->complexity() << " at eval = " << eval << endl;
@@ -21,7 +21,8 @@ class game_generator {
   agent_ptr prepared_player(input_sampler isam, agent_f gen, float plim) const;
   std::vector<agent_ptr> prepare_n(agent_f gen, int n, float plim) const;
   game_ptr team_bots_vs(agent_ptr a) const;
-  std::vector<agent_ptr> make_teams(std::vector<agent_ptr> ps) const;
+  // ppt clones of each agent, the clones of a team share one evaluator when shared_seats is set (headless games)
+  std::vector<agent_ptr> make_teams(std::vector<agent_ptr> ps, bool shared_seats = false) const;
   input_sampler generate_input_sampler(int n = 10) const;
   int choice_dim() const;
 };
\ No newline at end of file
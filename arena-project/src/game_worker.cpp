@@ -0,0 +1,349 @@
+#include "game_worker.hpp"
+
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "agent.hpp"
+#include "evaluator.hpp"
+#include "game.hpp"
+#include "game_generator.hpp"
+#include "ipc.hpp"
+#include "profiling.hpp"
+#include "utility.hpp"
+
+using namespace std;
+
+// an agent is sent as the serialization without its evaluator plus the
+// evaluator, which is left empty when the worker already has it cached
+struct agent_blob {
+  string head;
+  string eval;
+  size_t hash;
+};
+
+agent_blob split_agent(agent_ptr a) {
+  string s = serialize_agent(a);
+  string e = serialize_evaluator(a->eval);
+  assert(s.size() >= e.size() && s.compare(s.size() - e.size(), e.size(), e) == 0);
+  return {s.substr(0, s.size() - e.size()), e, hash<string>()(e)};
+}
+
+// binary result records, both ends run the same build so native layout is used
+template <typename T>
+void put(string &buf, T x) {
+  buf.append((const char *)&x, sizeof(T));
+}
+
+void put_vec(string &buf, const vec &x) {
+  put<int>(buf, x.size());
+  buf.append((const char *)x.data(), x.size() * sizeof(scalar));
+}
+
+void put_record(string &buf, const record &r) {
+  put_vec(buf, r.state);
+  put<int>(buf, r.opts.size());
+  for (auto &o : r.opts) {
+    put_vec(buf, o.choice);
+    put_vec(buf, o.input);
+    put<scalar>(buf, o.output);
+    put<int>(buf, o.original_idx);
+  }
+  put<int>(buf, r.selected_option);
+  put<double>(buf, r.reward);
+  put<double>(buf, r.sum_future_rewards);
+}
+
+// reads past the end leave ok() false instead of touching memory
+struct byte_reader {
+  const char *p;
+  const char *end;
+
+  byte_reader(const string &buf) : p(buf.data()), end(buf.data() + buf.size()) {}
+  bool ok() const { return p <= end; }
+
+  template <typename T>
+  T get() {
+    T x = T();
+    if (p + sizeof(T) <= end) memcpy(&x, p, sizeof(T));
+    p += sizeof(T);
+    return x;
+  }
+
+  vec get_vec() {
+    int n = get<int>();
+    if (n < 0 || !ok() || end - p < n * sizeof(scalar)) {
+      p = end + 1;
+      return vec();
+    }
+    vec x(n);
+    memcpy(x.data(), p, n * sizeof(scalar));
+    p += n * sizeof(scalar);
+    return x;
+  }
+
+  record get_record() {
+    record r;
+    r.state = get_vec();
+    int n = get<int>();
+    if (n < 0 || !ok()) n = 0;
+    for (int i = 0; i < n && ok(); i++) {
+      option o;
+      o.choice = get_vec();
+      o.input = get_vec();
+      o.output = get<scalar>();
+      o.original_idx = get<int>();
+      r.opts.push_back(o);
+    }
+    r.selected_option = get<int>();
+    r.reward = get<double>();
+    r.sum_future_rewards = get<double>();
+    return r;
+  }
+};
+
+// worker loop: play games until the coordinator closes the connection
+void serve_games(int fd, game_generator_ptr gg) {
+  hm<size_t, string> cache;
+  string msg;
+
+  while (ipc::recv_message(fd, msg)) {
+    stringstream ss(msg);
+    string cmd;
+    ss >> cmd;
+
+    if (cmd == "reset") {
+      cache.clear();
+      continue;
+    }
+
+    int epoch, n;
+    unsigned int seed;
+    ss >> epoch >> seed >> n;
+
+    vector<agent_ptr> agents(n);
+    for (auto &a : agents) {
+      size_t h;
+      string head, eval;
+      ss >> h;
+      if (!ipc::recv_message(fd, head) || !ipc::recv_message(fd, eval)) return;
+      if (eval.length()) cache[h] = eval;
+
+      stringstream as(head + cache.at(h));
+      a = deserialize_agent(as);
+    }
+
+    seed_random_engine(seed);
+    game_ptr g = gg->generate_starting_state(gg->make_teams(agents));
+    g->original_agents = agents;
+    auto res = g->play(epoch);
+    if (g->winner == -1) g->select_winner();
+
+    string buf;
+    put<int>(buf, g->winner);
+    put<int>(buf, g->turns_played);
+    put<int>(buf, res.size());
+    for (auto &x : res) {
+      agent_ptr p = g->players.at(x.first);
+      put<int>(buf, p->team);
+      put<int>(buf, p->team_index);
+      put<int>(buf, x.second.size());
+      for (auto &r : x.second) put_record(buf, r);
+    }
+
+    if (!ipc::send_message(fd, buf)) return;
+  }
+}
+
+// map the worker's records back to the clone ids of the local game
+bool apply_result(game_ptr g, const string &msg) {
+  byte_reader in(msg);
+  int winner = in.get<int>();
+  int turns = in.get<int>();
+  int n = in.get<int>();
+
+  hm<int, vector<record>> res;
+  for (int i = 0; i < n && in.ok(); i++) {
+    int team = in.get<int>();
+    int team_index = in.get<int>();
+    int nrec = in.get<int>();
+
+    int pid = -1;
+    for (auto &x : g->players) {
+      if (x.second->team == team && x.second->team_index == team_index) pid = x.first;
+    }
+    if (pid < 0) return false;
+
+    for (int j = 0; j < nrec && in.ok(); j++) res[pid].push_back(in.get_record());
+  }
+
+  if (!in.ok()) return false;
+
+  g->winner = winner;
+  g->turns_played = turns;
+  g->result_buf = res;
+  profiling::count(profiling::PC_GAMES);
+  profiling::count(profiling::PC_TURNS, turns);
+  return true;
+}
+
+game_worker_pool::game_worker_pool(int n, function<game_generator_ptr()> make_ggen) : cache_epoch(-1) {
+  int port = 0;
+  int server_fd = ipc::listen_tcp("127.0.0.1", port, n);
+  workers.resize(n);
+
+  for (int i = 0; i < n; i++) {
+    int pid = fork();
+    if (pid < 0) throw runtime_error("game_worker_pool: fork failed");
+
+    if (pid == 0) {
+      ipc::close_socket(server_fd);
+      try {
+        int fd = ipc::connect_tcp("127.0.0.1", port);
+        ipc::send_message(fd, to_string(i));
+        serve_games(fd, make_ggen());
+        ipc::close_socket(fd);
+      } catch (exception &e) {
+        cerr << "Game worker " << i << ": " << e.what() << endl;
+        _exit(1);
+      }
+      _exit(0);
+    }
+
+    workers[i].fd = -1;
+    workers[i].pid = pid;
+  }
+
+  // workers connect before building their game generator, so accept does not wait long
+  for (int i = 0; i < n; i++) {
+    int fd = ipc::accept_client(server_fd);
+    string msg;
+    if (ipc::recv_message(fd, msg)) {
+      workers[stoi(msg)].fd = fd;
+    } else {
+      ipc::close_socket(fd);
+    }
+  }
+
+  ipc::close_socket(server_fd);
+  cout << "game_worker_pool: " << live_workers() << " workers on port " << port << endl;
+}
+
+game_worker_pool::~game_worker_pool() {
+  for (auto &w : workers) ipc::close_socket(w.fd);
+  for (auto &w : workers) waitpid(w.pid, 0, 0);
+}
+
+int game_worker_pool::live_workers() const {
+  int n = 0;
+  for (auto &w : workers) n += w.fd >= 0;
+  return n;
+}
+
+void game_worker_pool::drop(worker &w) {
+  cout << "game_worker_pool: lost worker " << w.pid << ", requeueing its game" << endl;
+  ipc::close_socket(w.fd);
+  w.fd = -1;
+  w.cached.clear();
+}
+
+void game_worker_pool::play(vector<game_ptr> games, int epoch) {
+  // evaluators are trained between epochs, so cached copies are only valid within one
+  if (epoch != cache_epoch) {
+    for (auto &w : workers) {
+      if (w.fd >= 0 && !ipc::send_message(w.fd, "reset")) drop(w);
+      w.cached.clear();
+    }
+    cache_epoch = epoch;
+  }
+
+  // serialize each agent once per round, seeds are fixed per game so a requeued game starts the same
+  hm<agent *, agent_blob> blobs;
+  vector<unsigned int> seeds(games.size());
+  deque<int> pending;
+  for (int i = 0; i < games.size(); i++) {
+    for (auto a : games[i]->original_agents) {
+      if (!blobs.count(a.get())) blobs[a.get()] = split_agent(a);
+    }
+    seeds[i] = rand_int(0, INT32_MAX);
+    pending.push_back(i);
+  }
+
+  auto send_task = [&](worker &w, int idx) -> bool {
+    game_ptr g = games[idx];
+    stringstream ss;
+    ss << "task" << sep << epoch << sep << seeds[idx] << sep << g->original_agents.size();
+    for (auto a : g->original_agents) ss << sep << blobs[a.get()].hash;
+
+    bool ok = ipc::send_message(w.fd, ss.str());
+    for (auto a : g->original_agents) {
+      agent_blob &b = blobs[a.get()];
+      ok = ok && ipc::send_message(w.fd, b.head) && ipc::send_message(w.fd, w.cached.count(b.hash) ? "" : b.eval);
+      w.cached.insert(b.hash);
+    }
+    return ok;
+  };
+
+  vector<int> inflight(workers.size(), -1);
+  int done = 0;
+
+  while (done < games.size()) {
+    for (int k = 0; k < workers.size(); k++) {
+      worker &w = workers[k];
+      if (w.fd < 0 || inflight[k] >= 0 || pending.empty()) continue;
+
+      int idx = pending.front();
+      pending.pop_front();
+      if (send_task(w, idx)) {
+        inflight[k] = idx;
+      } else {
+        drop(w);
+        pending.push_front(idx);
+      }
+    }
+
+    vector<pollfd> pfds;
+    vector<int> pw;
+    for (int k = 0; k < workers.size(); k++) {
+      if (workers[k].fd < 0 || inflight[k] < 0) continue;
+      pfds.push_back({workers[k].fd, POLLIN, 0});
+      pw.push_back(k);
+    }
+
+    if (pfds.empty()) {
+      // all workers are gone, finish the round locally
+      cout << "game_worker_pool: no workers left, playing " << pending.size() << " games locally" << endl;
+      vector<int> rest(pending.begin(), pending.end());
+#pragma omp parallel for
+      for (int i = 0; i < rest.size(); i++) games[rest[i]]->result_buf = games[rest[i]]->play(epoch);
+      return;
+    }
+
+    if (poll(pfds.data(), pfds.size(), -1) < 0) {
+      if (errno == EINTR) continue;
+      throw runtime_error(string("game_worker_pool: poll failed: ") + strerror(errno));
+    }
+
+    for (int j = 0; j < pfds.size(); j++) {
+      if (!pfds[j].revents) continue;
+
+      int k = pw[j];
+      string msg;
+      if (ipc::recv_message(workers[k].fd, msg) && apply_result(games[inflight[k]], msg)) {
+        done++;
+      } else {
+        drop(workers[k]);
+        pending.push_back(inflight[k]);
+      }
+      inflight[k] = -1;
+    }
+  }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "types.hpp"
+
+// Pool of forked game worker processes connected over tcp loopback. Each game
+// is sent as serialized agents and a seed, the worker plays it and returns the
+// winner and training records in a compact binary record. Evaluators are
+// cached on the workers by content hash until the epoch changes, and games on
+// a worker that dies are requeued to the remaining workers.
+class game_worker_pool {
+  struct worker {
+    int fd;
+    int pid;
+    std::set<size_t> cached;
+  };
+
+  std::vector<worker> workers;
+  int cache_epoch;
+
+  void drop(worker &w);
+
+ public:
+  typedef std::shared_ptr<game_worker_pool> ptr;
+
+  // fork before anything starts an openmp team, make_ggen is called in each worker
+  game_worker_pool(int n, std::function<game_generator_ptr()> make_ggen);
+  ~game_worker_pool();
+
+  int live_workers() const;
+
+  // play all games, filling in winner, turns_played and result_buf as play does
+  void play(std::vector<game_ptr> games, int epoch);
+};
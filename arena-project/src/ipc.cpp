@@ -0,0 +1,146 @@
+#include "ipc.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace ipc {
+sockaddr_un unix_address(string path) {
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.length() >= sizeof(addr.sun_path)) throw runtime_error("ipc: socket path too long: " + path);
+  strcpy(addr.sun_path, path.c_str());
+  return addr;
+}
+
+int listen_unix(string path, int backlog) {
+  sockaddr_un addr = unix_address(path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) throw runtime_error("ipc: failed to create socket");
+
+  unlink(path.c_str());
+  if (bind(fd, (sockaddr *)&addr, sizeof(addr)) || listen(fd, backlog)) {
+    close(fd);
+    throw runtime_error("ipc: failed to listen on " + path + ": " + strerror(errno));
+  }
+
+  return fd;
+}
+
+int accept_client(int server_fd) {
+  int fd;
+  do {
+    fd = accept(server_fd, 0, 0);
+  } while (fd < 0 && errno == EINTR);
+
+  if (fd < 0) throw runtime_error(string("ipc: accept failed: ") + strerror(errno));
+  return fd;
+}
+
+int connect_unix(string path) {
+  sockaddr_un addr = unix_address(path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) throw runtime_error("ipc: failed to create socket");
+
+  if (connect(fd, (sockaddr *)&addr, sizeof(addr))) {
+    close(fd);
+    throw runtime_error("ipc: failed to connect to " + path + ": " + strerror(errno));
+  }
+
+  return fd;
+}
+
+sockaddr_in tcp_address(string host, int port) {
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) throw runtime_error("ipc: invalid address " + host);
+  return addr;
+}
+
+int listen_tcp(string host, int &port, int backlog) {
+  sockaddr_in addr = tcp_address(host, port);
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) throw runtime_error("ipc: failed to create socket");
+
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  socklen_t len = sizeof(addr);
+  if (bind(fd, (sockaddr *)&addr, sizeof(addr)) || listen(fd, backlog) || getsockname(fd, (sockaddr *)&addr, &len)) {
+    close(fd);
+    throw runtime_error("ipc: failed to listen on " + host + ":" + to_string(port) + ": " + strerror(errno));
+  }
+
+  port = ntohs(addr.sin_port);
+  return fd;
+}
+
+int connect_tcp(string host, int port) {
+  sockaddr_in addr = tcp_address(host, port);
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) throw runtime_error("ipc: failed to create socket");
+
+  // small messages go back and forth per game, don't wait to coalesce them
+  int on = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+  if (connect(fd, (sockaddr *)&addr, sizeof(addr))) {
+    close(fd);
+    throw runtime_error("ipc: failed to connect to " + host + ":" + to_string(port) + ": " + strerror(errno));
+  }
+
+  return fd;
+}
+
+void close_socket(int fd) {
+  if (fd >= 0) close(fd);
+}
+
+bool write_all(int fd, const char *buf, size_t n) {
+  while (n > 0) {
+    ssize_t k = send(fd, buf, n, MSG_NOSIGNAL);
+    if (k < 0 && errno == EINTR) continue;
+    if (k <= 0) return false;
+    buf += k;
+    n -= k;
+  }
+  return true;
+}
+
+bool read_all(int fd, char *buf, size_t n) {
+  while (n > 0) {
+    ssize_t k = recv(fd, buf, n, 0);
+    if (k < 0 && errno == EINTR) continue;
+    if (k <= 0) return false;
+    buf += k;
+    n -= k;
+  }
+  return true;
+}
+
+bool send_message(int fd, const string &msg) {
+  uint32_t len = msg.size();
+  return write_all(fd, (const char *)&len, sizeof(len)) && write_all(fd, msg.data(), len);
+}
+
+bool recv_message(int fd, string &msg) {
+  uint32_t len;
+  if (!read_all(fd, (char *)&len, sizeof(len))) return false;
+
+  msg.resize(len);
+  return read_all(fd, &msg[0], len);
+}
+};  // namespace ipc
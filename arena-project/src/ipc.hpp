@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+// Blocking unix domain and tcp socket helpers. Messages are framed with a 4
+// byte length prefix so a whole serialized payload is read or written per call.
+namespace ipc {
+int listen_unix(std::string path, int backlog);
+int accept_client(int server_fd);
+int connect_unix(std::string path);
+
+// port 0 picks a free port, which is written back to port
+int listen_tcp(std::string host, int &port, int backlog);
+int connect_tcp(std::string host, int port);
+
+void close_socket(int fd);
+
+// false if the peer is gone, sends never raise SIGPIPE
+bool send_message(int fd, const std::string &msg);
+bool recv_message(int fd, std::string &msg);
+};  // namespace ipc
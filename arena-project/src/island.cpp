@@ -0,0 +1,251 @@
+#include "island.hpp"
+
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "agent.hpp"
+#include "async_io.hpp"
+#include "ipc.hpp"
+#include "population_manager.hpp"
+#include "utility.hpp"
+
+using namespace std;
+
+// agent ids are drawn from a separate range on each island so migrants never collide
+const int island_id_stride = 1e8;
+// seconds the coordinator waits for the workers to connect, they connect before doing any work
+const int island_connect_timeout = 60;
+
+island_options::island_options() {
+  islands = 0;
+  interval = 5;
+  migrants = 2;
+  topology = "ring";
+  socket_path = "/tmp/arena-islands-" + to_string(getpid()) + ".sock";
+  seed = 0;
+}
+
+// a migration batch is a header message "<epoch> <n>" followed by one message per serialized agent
+bool send_batch(int fd, unsigned int epoch, const vector<string> &agents) {
+  bool ok = ipc::send_message(fd, to_string(epoch) + sep + to_string(agents.size()));
+  for (auto &x : agents) ok = ok && ipc::send_message(fd, x);
+  return ok;
+}
+
+bool recv_batch(int fd, unsigned int &epoch, vector<string> &agents) {
+  string msg;
+  if (!ipc::recv_message(fd, msg)) return false;
+
+  int n;
+  stringstream ss(msg);
+  ss >> epoch >> n;
+  agents.resize(n);
+  for (auto &x : agents) {
+    if (!ipc::recv_message(fd, x)) return false;
+  }
+  return true;
+}
+
+// deserialize a migrant without moving this island's id counter into another island's range
+agent_ptr load_migrant(const string &blob) {
+  int idc = agent::idc;
+  stringstream ss(blob);
+  agent_ptr a = deserialize_agent(ss);
+  agent::idc = idc;
+  return a;
+}
+
+void island_worker(int island, island_options iopts, evolution_options opts, function<void(evolution_options)> run_island) {
+  seed_random_engine(iopts.seed ? iopts.seed + island : time(0) ^ (getpid() << 16));
+  agent::idc = island * island_id_stride;
+
+  int fd = ipc::connect_unix(iopts.socket_path);
+  ipc::send_message(fd, to_string(island));
+
+  opts.epoch_hook = [&fd, island, iopts](unsigned int epoch, population_manager_ptr pop) {
+    if (fd < 0 || epoch % iopts.interval) return;
+
+    pop->sortpop();
+    vector<string> out, in;
+    for (auto a : pop->topn(min<int>(iopts.migrants, pop->pop.size()))) out.push_back(serialize_agent(a));
+
+    unsigned int in_epoch;
+    if (!send_batch(fd, epoch, out) || !recv_batch(fd, in_epoch, in)) {
+      cout << "Island " << island << ": lost coordinator, continuing without migration" << endl;
+      ipc::close_socket(fd);
+      fd = -1;
+      return;
+    }
+
+    vector<agent_ptr> buf;
+    for (auto &x : in) buf.push_back(load_migrant(x));
+    pop->immigrate(buf);
+    cout << "Island " << island << ": epoch " << epoch << ": received " << buf.size() << " migrants" << endl;
+  };
+
+  run_island(opts);
+  ipc::close_socket(fd);
+}
+
+// source islands for each receiving island, over the islands still alive
+vector<vector<int>> migration_sources(string topology, vector<int> live) {
+  int n = live.size();
+  vector<vector<int>> sources(n);
+  if (n < 2) return sources;
+
+  for (int k = 0; k < n; k++) {
+    if (topology == "ring") {
+      sources[k] = {live[(k + n - 1) % n]};
+    } else if (topology == "full") {
+      for (int j = 0; j < n; j++) {
+        if (j != k) sources[k].push_back(live[j]);
+      }
+    } else if (topology == "random") {
+      int j = rand_int(0, n - 2);
+      sources[k] = {live[j < k ? j : j + 1]};
+    } else {
+      throw runtime_error("Invalid island topology: " + topology);
+    }
+  }
+
+  return sources;
+}
+
+// accept a connection from each island, giving up on islands whose worker exits or times out before connecting.
+// workers that are reaped here are set to -1.
+vector<int> accept_islands(int server_fd, vector<pid_t> &workers) {
+  int n = workers.size();
+  vector<int> fds(n, -1);
+  auto deadline = chrono::steady_clock::now() + chrono::seconds(island_connect_timeout);
+
+  while (true) {
+    int pending = 0;
+    for (int i = 0; i < n; i++) {
+      if (fds[i] >= 0 || workers[i] < 0) continue;
+      if (waitpid(workers[i], 0, WNOHANG) == workers[i]) {
+        cout << "Islands: island " << i << " exited before connecting" << endl;
+        workers[i] = -1;
+      } else {
+        pending++;
+      }
+    }
+
+    if (!pending) break;
+    if (chrono::steady_clock::now() > deadline) {
+      for (int i = 0; i < n; i++) {
+        if (fds[i] >= 0 || workers[i] < 0) continue;
+        cout << "Islands: island " << i << " did not connect, stopping it" << endl;
+        kill(workers[i], SIGTERM);
+      }
+      break;
+    }
+
+    pollfd p = {server_fd, POLLIN, 0};
+    int ready = poll(&p, 1, 1000);
+    if (ready < 0 && errno != EINTR) throw runtime_error(string("Islands: poll failed: ") + strerror(errno));
+    if (ready <= 0) continue;
+
+    int fd = ipc::accept_client(server_fd);
+    string msg;
+    int i = ipc::recv_message(fd, msg) ? stoi(msg) : -1;
+    if (i < 0 || i >= n || fds[i] >= 0) {
+      ipc::close_socket(fd);
+      continue;
+    }
+    fds[i] = fd;
+  }
+
+  return fds;
+}
+
+void island_coordinator(int server_fd, island_options iopts, vector<pid_t> &workers) {
+  int n = iopts.islands;
+  vector<int> fds = accept_islands(server_fd, workers);
+
+  while (true) {
+    // every island sends at the same epochs, so blocking reads in island order are safe.
+    // agents are forwarded as opaque blobs.
+    vector<vector<string>> emigrants(n);
+    vector<int> live;
+    unsigned int epoch = 0;
+
+    for (int i = 0; i < n; i++) {
+      if (fds[i] < 0) continue;
+
+      if (!recv_batch(fds[i], epoch, emigrants[i])) {
+        cout << "Islands: island " << i << " disconnected" << endl;
+        ipc::close_socket(fds[i]);
+        fds[i] = -1;
+        continue;
+      }
+
+      live.push_back(i);
+    }
+
+    if (live.empty()) break;
+
+    vector<vector<int>> sources = migration_sources(iopts.topology, live);
+    for (int k = 0; k < live.size(); k++) {
+      vector<string> buf;
+      for (auto j : sources[k]) buf = vec_append(buf, emigrants[j]);
+
+      if (!send_batch(fds[live[k]], epoch, buf)) {
+        ipc::close_socket(fds[live[k]]);
+        fds[live[k]] = -1;
+      }
+    }
+
+    cout << "Islands: epoch " << epoch << ": migrated between " << live.size() << " islands (" << iopts.topology << ")" << endl;
+  }
+}
+
+void island_evolution(island_options iopts, evolution_options opts, function<void(evolution_options)> run_island) {
+  if (iopts.islands < 1 || iopts.islands > INT32_MAX / island_id_stride) throw runtime_error("Invalid number of islands: " + to_string(iopts.islands));
+  if (iopts.interval < 1) throw runtime_error("Invalid migration interval: " + to_string(iopts.interval));
+  migration_sources(iopts.topology, {0, 1});
+
+  // listen before forking so workers can connect immediately
+  int server_fd = ipc::listen_unix(iopts.socket_path, iopts.islands);
+  vector<pid_t> workers;
+
+  for (int i = 0; i < iopts.islands; i++) {
+    pid_t pid = fork();
+    if (pid < 0) throw runtime_error("Islands: fork failed");
+
+    if (pid == 0) {
+      ipc::close_socket(server_fd);
+      try {
+        island_worker(i, iopts, opts, run_island);
+      } catch (exception &e) {
+        cerr << "Island " << i << ": " << e.what() << endl;
+        async_io::drain();
+        _exit(1);
+      }
+      // _exit skips static destructors, so the stats, profile rows and brain dumps of the last epoch that are still
+      // queued are written first
+      async_io::drain();
+      _exit(0);
+    }
+
+    workers.push_back(pid);
+  }
+
+  island_coordinator(server_fd, iopts, workers);
+
+  for (auto pid : workers) {
+    if (pid > 0) waitpid(pid, 0, 0);
+  }
+  ipc::close_socket(server_fd);
+  unlink(iopts.socket_path.c_str());
+}
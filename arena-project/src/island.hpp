@@ -0,0 +1,24 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "arena.hpp"
+
+// Island model: one forked evolution process per island, each with its own
+// population. Every interval epochs all islands send their top agents to a
+// coordinator over a unix socket, which routes them according to the topology
+// (ring, full or random) and sends each island its immigrants.
+struct island_options {
+  int islands;
+  int interval;
+  int migrants;
+  std::string topology;
+  std::string socket_path;
+  unsigned int seed;
+
+  island_options();
+};
+
+// runs the coordinator in the calling process, run_island is called once in each worker
+void island_evolution(island_options iopts, evolution_options opts, std::function<void(evolution_options)> run_island);
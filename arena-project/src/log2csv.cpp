@@ -0,0 +1,20 @@
+#include <cstring>
+#include <iostream>
+
+#include "run_log.hpp"
+
+using namespace std;
+
+// Usage: log2csv file [header]
+// Writes the rows of a run log to stdout as csv, with a line of column names first if header is given
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    cerr << "Usage: log2csv file [header]" << endl;
+    return 1;
+  }
+
+  bool header = argc > 2 && !strcmp(argv[2], "header");
+  ios::sync_with_stdio(false);
+  run_log_reader(argv[1]).write_csv(cout, header);
+  return 0;
+}
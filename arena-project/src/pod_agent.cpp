@@ -13,6 +13,7 @@ pod_agent::pod_agent() : agent() {
 
 agent_ptr pod_agent::clone() const {
   shared_ptr<pod_agent> a(new pod_agent(*this));
+  a->assign_id();
   a->eval = eval->clone();
   a->csel = choice_selector_ptr(new choice_selector(*csel));
   a->parent_buf.clear();
@@ -21,3 +22,12 @@ agent_ptr pod_agent::clone() const {
 
   return a;
 }
+
+agent_ptr pod_agent::clone_seat() const {
+  shared_ptr<pod_agent> a(new pod_agent(*this));
+  a->assign_id();
+  a->csel = choice_selector_ptr(new choice_selector(*csel));
+  a->parent_buf.clear();
+
+  return a;
+}
@@ -27,4 +27,5 @@ class pod_agent : public agent {
 
   pod_agent();
   agent_ptr clone() const override;
+  agent_ptr clone_seat() const override;
 };
@@ -10,6 +10,8 @@
 #include "agent.hpp"
 #include "evaluator.hpp"
 #include "pod_agent.hpp"
+#include "profiling.hpp"
+#include "run_log.hpp"
 #include "utility.hpp"
 
 using namespace std;
@@ -18,6 +20,8 @@ using namespace pod_game_parameters;
 void pod_game::initialize() {
   reset();
 
+  seed = rand_int(0, INT32_MAX);
+  rng.seed(seed);
   run_laps = rand_int(1, 3);
 
   // generate checkpoints
@@ -59,56 +63,87 @@ void pod_game::setup_from_input(istream &s) {
   for (auto &p : checkpoint) s >> p.x >> p.y;
 }
 
+void pod_game::start_replay(pod_replay *r) {
+  r->seed = seed;
+  r->run_laps = run_laps;
+  r->max_turns = max_turns;
+  r->checkpoint = checkpoint;
+  r->pods.clear();
+  for (auto x : typed_agents) r->pods.push_back({x.first, x.second->team, x.second->team_index, x.second->data});
+  sort(r->pods.begin(), r->pods.end(), [](const pod_replay::pod &a, const pod_replay::pod &b) {
+    return a.team < b.team || (a.team == b.team && a.team_index < b.team_index);
+  });
+  r->choices.clear();
+  r->winner = winner;
+  r->final_state.clear();
+  for (auto &p : r->pods) r->final_state.push_back(p.start);
+  replay = r;
+}
+
+void pod_game::setup_from_replay(const pod_replay &r) {
+  reset();
+
+  seed = r.seed;
+  rng.seed(seed);
+  run_laps = r.run_laps;
+  max_turns = r.max_turns;
+  checkpoint = r.checkpoint;
+  for (auto &p : r.pods) typed_agents.at(p.pid)->data = p.start;
+}
+
 int pod_choice::vector_dim() { return 4; }
 bool pod_choice::validate() { return true; }
 
 pod_game::pod_game(player_table pl) : game(pl) {
   max_turns = 300;
+  seed = 0;
+  replay = 0;
   for (auto x : players) {
     typed_agents[x.first] = static_pointer_cast<pod_agent>(x.second);
   }
 }
 
-record_table pod_game::increment(string row_prefix) {
-  record_table res;
-  hm<int, double> dtab_before;
-  auto ttab_before = ttable();
-  auto agents = typed_agents;
+record_table pod_game::increment(const log_row &row_prefix) {
+  profiling::count(profiling::PC_TURNS);
+  return play_turn([this](int pid) { return typed_agents.at(pid)->select_choice(shared_from_this()); }, row_prefix);
+}
 
-  // proceess choices
-  for (auto x : agents) {
-    int pid = x.first;
-    pod_agent::ptr p = x.second;
-    dtab_before[pid] = pod_distance_travelled(pid);
+record_table pod_game::apply_turn(record_table decisions, const log_row &row_prefix) {
+  return play_turn([&decisions](int pid) { return decisions.at(pid); }, row_prefix);
+}
 
-    res[pid] = p->select_choice(shared_from_this());
-    vec csel = res[pid].opts[res[pid].selected_option].choice;
-    shared_ptr<pod_choice> c = static_pointer_cast<pod_choice>(unvectorize_choice(csel));
+// apply a vectorized choice to a pod, as unvectorize_choice reads it
+void pod_game::move_pod(pod_data &d, const vec &c) {
+  double angle = c[0];
+  double thrust = c[1];
+  bool boost = c[2];
+  bool shield = c[3];
 
-    p->data.a += fmin(angular_speed, fabs(c->angle)) * signum(c->angle);
+  d.a += fmin(angular_speed, fabs(angle)) * signum(angle);
 
-    if (p->data.shield_active) {
-      p->data.shield_active--;
-    } else if (c->shield) {
-      p->data.shield_active = 3;
-    } else {
-      if (c->boost) {
-        p->data.boost_count = false;
-        c->thrust = 650;
-      }
-      p->data.v = p->data.v + c->thrust * normv(p->data.a);
+  if (d.shield_active) {
+    d.shield_active--;
+  } else if (shield) {
+    d.shield_active = 3;
+  } else {
+    if (boost) {
+      d.boost_count = false;
+      thrust = 650;
     }
-
-    p->data.x = p->data.x + p->data.v;
-    // todo: collision here?
-    p->data.v = friction * p->data.v;
-    p->data.v = truncate_point(p->data.v);
-    p->data.x = truncate_point(p->data.x);
+    d.v = d.v + thrust * normv(d.a);
   }
 
-  // check collisions
+  d.x = d.x + d.v;
+  // todo: collision here?
+  d.v = friction * d.v;
+  d.v = truncate_point(d.v);
+  d.x = truncate_point(d.x);
+}
+
+// collisions and checkpoints after all pods moved
+void pod_game::resolve_turn() {
   vector<pod_data *> check;
-  for (auto &x : agents) check.push_back(&x.second->data);
+  for (auto &x : typed_agents) check.push_back(&x.second->data);
 
   int n = check.size();
   for (int i = 0; i < n - 1; i++) {
@@ -123,8 +158,9 @@ record_table pod_game::increment(string row_prefix) {
 
         if (!(isfinite(proj) && fabs(proj) < 1e6)) {
           // pods standing on top of each other
-          check[i]->x = check[i]->x + point{rnorm(0, 10), rnorm(0, 10)};
-          check[j]->x = check[j]->x + point{rnorm(0, 10), rnorm(0, 10)};
+          normal_distribution<double> jitter(0, 10);
+          check[i]->x = check[i]->x + point{jitter(rng), jitter(rng)};
+          check[j]->x = check[j]->x + point{jitter(rng), jitter(rng)};
           continue;
         }
 
@@ -140,7 +176,7 @@ record_table pod_game::increment(string row_prefix) {
   }
 
   // update checkpoint and lap info
-  for (auto x : agents) {
+  for (auto x : typed_agents) {
     pod_agent::ptr p = x.second;
     int pid = x.first;
 
@@ -157,6 +193,31 @@ record_table pod_game::increment(string row_prefix) {
       }
     }
   }
+}
+
+void pod_game::step() {
+  profiling::count(profiling::PC_TURNS);
+  for (auto x : typed_agents) move_pod(x.second->data, x.second->decide(shared_from_this()));
+  resolve_turn();
+}
+
+record_table pod_game::play_turn(function<record(int pid)> choose, const log_row &row_prefix) {
+  record_table res;
+  hm<int, double> dtab_before;
+  auto ttab_before = ttable();
+  auto agents = typed_agents;
+
+  // proceess choices
+  for (auto x : agents) {
+    int pid = x.first;
+    pod_agent::ptr p = x.second;
+    dtab_before[pid] = pod_distance_travelled(pid);
+
+    res[pid] = choose(pid);
+    move_pod(p->data, res[pid].opts[res[pid].selected_option].choice);
+  }
+
+  resolve_turn();
 
   auto ttab_after = ttable();
 
@@ -188,30 +249,39 @@ record_table pod_game::increment(string row_prefix) {
     res[x.first].sum_future_rewards = 0;
   }
 
+  if (replay) {
+    for (auto &p : replay->pods) replay->choices.push_back(res[p.pid].selected_option);
+    replay->winner = winner;
+    for (int i = 0; i < replay->pods.size(); i++) replay->final_state[i] = typed_agents.at(replay->pods[i].pid)->data;
+  }
+
   // todo: validate that pods pass checkpoints and laps
   if (enable_output) {
     string cp_xs = join_string(map<point, string>([](point a) -> string { return to_string(int(a.x)); }, checkpoint), " ");
     string cp_ys = join_string(map<point, string>([](point a) -> string { return to_string(int(a.y)); }, checkpoint), " ");
 
-    // write csv output
+    // one row per pod
+    vector<log_row> rows;
     for (auto x : typed_agents) {
       int pid = x.first;
       pod_agent::ptr p = x.second;
-      (*enable_output) << row_prefix
-                       << game_id << comma
-                       << turns_played << comma
-                       << p->team << comma
-                       << p->data.lap << comma
-                       << pid << comma
-                       << p->data.x.x << comma
-                       << p->data.x.y << comma
-                       << p->data.a << comma
-                       << p->data.shield_active << comma
-                       << p->data.boost_count << comma
-                       << res[pid].reward << comma
-                       << cp_xs << comma
-                       << cp_ys << endl;
+      rows.push_back(row_prefix);
+      rows.back()
+          .i64(game_id)
+          .i64(turns_played)
+          .i64(p->team)
+          .i64(p->data.lap)
+          .i64(pid)
+          .f64(p->data.x.x)
+          .f64(p->data.x.y)
+          .f64(p->data.a)
+          .i64(p->data.shield_active)
+          .i64(p->data.boost_count)
+          .f64(res[pid].reward)
+          .str(cp_xs)
+          .str(cp_ys);
     }
+    enable_output->append(move(rows));
   }
 
   return res;
@@ -221,6 +291,20 @@ bool pod_game::finished() {
   return did_finish;
 }
 
+// the leading team is ahead of all other teams by at least margin laps
+bool pod_game::outcome_decided(double margin) {
+  double first = -INFINITY, second = -INFINITY;
+  for (auto x : ttable()) {
+    if (x.second > first) {
+      second = first;
+      first = x.second;
+    } else if (x.second > second) {
+      second = x.second;
+    }
+  }
+  return first - second >= margin * lap_length();
+}
+
 std::string pod_game::end_stats() {
   stringstream ss;
 
@@ -255,18 +339,26 @@ void pod_game::reset() {
   run_laps = 0;
 }
 
+const vector<double> &pod_game::option_angles() {
+  static const vector<double> angles = [] {
+    vector<double> res;
+    for (double a = -angular_speed; a <= angular_speed; a += angular_speed / 3) res.push_back(a);
+    return res;
+  }();
+  return angles;
+}
+
 std::vector<choice_ptr> pod_game::generate_choices(agent_ptr p_base) {
   pod_agent::ptr p = static_pointer_cast<pod_agent>(p_base);
   vector<pod_choice> opts;
-  double thrust_limit = 100;
 
   pod_choice cx;
-  for (double a = -angular_speed; a <= angular_speed; a += angular_speed / 3) {
+  for (double a : option_angles()) {
     cx.angle = a;
     cx.boost = false;
     cx.shield = false;
-    for (double t = 0; t <= 100; t += 20) {
-      cx.thrust = fmin(t, thrust_limit);
+    for (double t = 0; t <= max_thrust; t += thrust_step) {
+      cx.thrust = t;
       opts.push_back(cx);
     }
     cx.boost = true;
@@ -289,7 +381,7 @@ vec pod_game::vectorize_state(int pid) const {
 
   // relative pod data: 13 datapoints
   pod_data a = typed_agents.at(pid)->data;
-  vector<double> x(typed_agents.size() * 13 + 1);
+  vec x(typed_agents.size() * 13 + 1);
   int idx = 0;
 
   // add the team index
@@ -337,7 +429,7 @@ vec pod_game::vectorize_state(int pid) const {
 
 vec pod_game::vectorize_choice(choice_ptr c_base, int pid) const {
   auto c = static_pointer_cast<pod_choice>(c_base);
-  return {c->angle, c->thrust, (double)c->boost, (double)c->shield};
+  return {(scalar)c->angle, (scalar)c->thrust, (scalar)c->boost, (scalar)c->shield};
 }
 
 choice_ptr pod_game::unvectorize_choice(vec x) const {
@@ -371,6 +463,12 @@ double pod_game::pod_distance_travelled(int pid) {
   return travel;
 }
 
+double pod_game::lap_length() const {
+  double dsum = 0;
+  for (int i = 0; i < checkpoint.size(); i++) dsum += distance(get_checkpoint(i), get_checkpoint(i + 1));
+  return dsum;
+}
+
 // table of heuristic score for all teams
 hm<int, double> pod_game::ttable() {
   hm<int, double> ttab;
@@ -1,11 +1,14 @@
 #pragma once
 
+#include <functional>
 #include <memory>
+#include <random>
 
 #include "agent.hpp"
 #include "choice.hpp"
 #include "game.hpp"
 #include "pod_agent.hpp"
+#include "pod_replay.hpp"
 #include "types.hpp"
 
 class pod_choice : public choice {
@@ -26,32 +29,54 @@ constexpr double pod_radius = 400;
 constexpr double angular_speed = 0.314;
 constexpr double friction = 0.85;
 constexpr double pod_mass = 1;
+constexpr double max_thrust = 100;
+constexpr double thrust_step = 20;
 };  // namespace pod_game_parameters
 
-class pod_game : public game, public std::enable_shared_from_this<pod_game> {
+class pod_game : public game {
  protected:
   hm<int, double> ttable();
   double pod_distance_travelled(int pid);
+  double lap_length() const;
 
   bool did_finish;
   int run_laps;
 
   point get_checkpoint(int idx) const;
+  void move_pod(pod_data &d, const vec &c);
+  void resolve_turn();
+
+  // randomness of the game itself, so it is reproduced from the seed when the game is replayed
+  std::mt19937 rng;
 
  public:
   std::vector<point> checkpoint;
   hm<int, pod_agent::ptr> typed_agents;
+  unsigned int seed;
+  pod_replay *replay;
 
   pod_game(player_table pl);
   void initialize() override;
   void setup_from_input(std::istream &s) override;
-  record_table increment(std::string row_prefix = "") override;
+  // record the game from its current state into r, as turns are applied
+  void start_replay(pod_replay *r);
+  // set up the recorded starting state, the players must have the recorded ids
+  void setup_from_replay(const pod_replay &r);
+  record_table increment(const log_row &row_prefix = log_row()) override;
+  record_table apply_turn(record_table decisions, const log_row &row_prefix = log_row()) override;
+  void step() override;
+  // move the pods one at a time with the choice returned by choose, which sees the moves of the pods before it
+  record_table play_turn(std::function<record(int pid)> choose, const log_row &row_prefix = log_row());
   bool finished() override;
+  bool outcome_decided(double margin) override;
   std::string end_stats() override;
   int select_winner() override;
   double score_simple(int pid) override;
   void reset() override;
   std::vector<choice_ptr> generate_choices(agent_ptr a) override;
+  // turn angles of the options, each with thrusts 0 to max_thrust in thrust_steps and a boost when available,
+  // followed by a shield option
+  static const std::vector<double> &option_angles();
   vec vectorize_choice(choice_ptr c, int pid) const override;
   vec vectorize_state(int pid) const override;
   choice_ptr unvectorize_choice(vec x) const override;
@@ -0,0 +1,207 @@
+#include "pod_replay.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "pod_game.hpp"
+
+using namespace std;
+
+// binary layout: magic, seed, run_laps, max_turns, checkpoints, pods with their starting state, the option index of
+// every pod and turn as one byte, then the winner and the final pod states
+const string replay_magic = "PODRPL1\n";
+
+namespace {
+template <typename T>
+void put(string &buf, T x) {
+  buf.append((const char *)&x, sizeof(T));
+}
+
+void put_pod(string &buf, const pod_data &d) {
+  put<double>(buf, d.x.x);
+  put<double>(buf, d.x.y);
+  put<double>(buf, d.v.x);
+  put<double>(buf, d.v.y);
+  put<double>(buf, d.a);
+  put<int8_t>(buf, d.passed_checkpoint);
+  put<int8_t>(buf, d.previous_checkpoint);
+  put<int8_t>(buf, d.lap);
+  put<int8_t>(buf, d.boost_count);
+  put<int8_t>(buf, d.shield_active);
+}
+
+struct replay_reader {
+  const char *p;
+  const char *end;
+
+  template <typename T>
+  T get() {
+    if (end - p < (ptrdiff_t)sizeof(T)) throw runtime_error("pod_replay: truncated replay");
+    T x;
+    memcpy(&x, p, sizeof(T));
+    p += sizeof(T);
+    return x;
+  }
+
+  pod_data get_pod() {
+    pod_data d;
+    d.x.x = get<double>();
+    d.x.y = get<double>();
+    d.v.x = get<double>();
+    d.v.y = get<double>();
+    d.a = get<double>();
+    d.passed_checkpoint = get<int8_t>();
+    d.previous_checkpoint = get<int8_t>();
+    d.lap = get<int8_t>();
+    d.boost_count = get<int8_t>();
+    d.shield_active = get<int8_t>();
+    return d;
+  }
+};
+
+bool same_state(const pod_data &a, const pod_data &b) {
+  return a.x.x == b.x.x && a.x.y == b.x.y && a.v.x == b.v.x && a.v.y == b.v.y && a.a == b.a &&
+         a.passed_checkpoint == b.passed_checkpoint && a.lap == b.lap && a.boost_count == b.boost_count &&
+         a.shield_active == b.shield_active;
+}
+}  // namespace
+
+int pod_replay::turns() const {
+  return pods.empty() ? 0 : choices.size() / pods.size();
+}
+
+string pod_replay::serialize() const {
+  string buf = replay_magic;
+  put<uint32_t>(buf, seed);
+  put<int8_t>(buf, run_laps);
+  put<int16_t>(buf, max_turns);
+
+  put<uint8_t>(buf, checkpoint.size());
+  for (auto &c : checkpoint) {
+    put<double>(buf, c.x);
+    put<double>(buf, c.y);
+  }
+
+  put<uint8_t>(buf, pods.size());
+  for (auto &p : pods) {
+    put<int32_t>(buf, p.pid);
+    put<int8_t>(buf, p.team);
+    put<int8_t>(buf, p.team_index);
+    put_pod(buf, p.start);
+  }
+
+  put<uint32_t>(buf, turns());
+  buf.append((const char *)choices.data(), choices.size());
+
+  put<int8_t>(buf, winner);
+  for (auto &d : final_state) put_pod(buf, d);
+  return buf;
+}
+
+void pod_replay::deserialize(const string &buf) {
+  if (buf.compare(0, replay_magic.size(), replay_magic)) throw runtime_error("pod_replay: not a replay");
+  replay_reader r = {buf.data() + replay_magic.size(), buf.data() + buf.size()};
+
+  seed = r.get<uint32_t>();
+  run_laps = r.get<int8_t>();
+  max_turns = r.get<int16_t>();
+
+  checkpoint.resize(r.get<uint8_t>());
+  for (auto &c : checkpoint) {
+    c.x = r.get<double>();
+    c.y = r.get<double>();
+  }
+
+  pods.resize(r.get<uint8_t>());
+  for (auto &p : pods) {
+    p.pid = r.get<int32_t>();
+    p.team = r.get<int8_t>();
+    p.team_index = r.get<int8_t>();
+    p.start = r.get_pod();
+  }
+
+  size_t n = (size_t)r.get<uint32_t>() * pods.size();
+  if (r.end - r.p < (ptrdiff_t)n) throw runtime_error("pod_replay: truncated replay");
+  choices.assign(r.p, r.p + n);
+  r.p += n;
+
+  winner = r.get<int8_t>();
+  final_state.resize(pods.size());
+  for (auto &d : final_state) d = r.get_pod();
+}
+
+void pod_replay::save(string filename) const {
+  ofstream f(filename, ios::binary);
+  if (!f) throw runtime_error("pod_replay: failed to write " + filename);
+  f << serialize();
+}
+
+void pod_replay::load(string filename) {
+  ifstream f(filename, ios::binary);
+  if (!f) throw runtime_error("pod_replay: failed to read " + filename);
+  stringstream ss;
+  ss << f.rdbuf();
+  deserialize(ss.str());
+}
+
+shared_ptr<pod_game> resimulate(const pod_replay &r, agent_ptr agent, int swap_team, int swap_turn, agent_ptr fallback) {
+  // pods with the recorded ids, inserted in the order make_teams creates them so the game iterates them as recorded
+  player_table pl;
+  vector<bool> swapped(r.pods.size());
+  for (int i = 0; i < r.pods.size(); i++) {
+    auto &p = r.pods[i];
+    swapped[i] = agent && p.team == swap_team;
+    agent_ptr a = swapped[i] ? agent->clone() : fallback ? fallback->clone() : agent_ptr(new pod_agent);
+    a->id = p.pid;
+    a->team = p.team;
+    a->team_index = p.team_index;
+    pl[p.pid] = a;
+  }
+
+  shared_ptr<pod_game> g(new pod_game(pl));
+  g->setup_from_replay(r);
+
+  const int n = r.pods.size();
+  hm<int, int> index;
+  for (int i = 0; i < n; i++) index[r.pods[i].pid] = i;
+
+  for (g->turns_played = 0; g->turns_remaining(); g->turns_played++) {
+    const int t = g->turns_played;
+    const bool recorded = t < r.turns();
+    if (!recorded && !fallback) {
+      bool all_swapped = true;
+      for (int i = 0; i < n; i++) all_swapped &= swapped[i];
+      if (!all_swapped) break;
+    }
+
+    // pods decide in the game's move order, so a swapped in agent sees the moves of the pods before it
+    g->play_turn([&](int pid) {
+      const int i = index.at(pid);
+      agent_ptr a = g->players.at(pid);
+      // only the option that is played is needed to apply the turn
+      record rec;
+      rec.opts.resize(1);
+      if (recorded && !(swapped[i] && t >= swap_turn)) {
+        rec.opts[0].choice = g->vectorize_choice(g->generate_choices(a).at(r.choices[t * n + i]), pid);
+      } else {
+        rec.opts[0].choice = a->decide(g);
+      }
+      rec.selected_option = 0;
+      rec.reward = 0;
+      rec.sum_future_rewards = 0;
+      return rec;
+    });
+  }
+
+  return g;
+}
+
+bool matches_recording(const pod_replay &r, shared_ptr<pod_game> g) {
+  if (g->winner != r.winner || g->turns_played != r.turns()) return false;
+  for (int i = 0; i < r.pods.size(); i++) {
+    if (!same_state(g->typed_agents.at(r.pods[i].pid)->data, r.final_state[i])) return false;
+  }
+  return true;
+}
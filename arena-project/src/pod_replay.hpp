@@ -0,0 +1,50 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "pod_agent.hpp"
+#include "types.hpp"
+
+class pod_game;
+
+// Compact record of a pod game: the track, the starting state of the pods, the seed of the game's own randomness and
+// the option each pod picked every turn. The options of a turn are generated from the game state, so this is enough
+// to play the game again exactly, or to let another agent take over from any turn.
+struct pod_replay {
+  struct pod {
+    int pid;
+    int team;
+    int team_index;
+    pod_data start;
+  };
+
+  unsigned int seed;
+  int run_laps;
+  int max_turns;
+  std::vector<point> checkpoint;
+  std::vector<pod> pods;  // in (team, team_index) order, which is the order make_teams creates them in
+
+  // option picked by pod i at turn t at t * pods.size() + i
+  std::vector<unsigned char> choices;
+
+  // outcome of the recorded game, to check re-simulations against
+  int winner;
+  std::vector<pod_data> final_state;
+
+  int turns() const;
+  std::string serialize() const;
+  void deserialize(const std::string &buf);
+  void save(std::string filename) const;
+  void load(std::string filename);
+};
+
+// Play r back, turn by turn. From turn swap_turn on, the pods of swap_team choose with clones of agent instead of
+// following the recording. When the recording runs out before the game ends the other pods choose with clones of
+// fallback, or the game stops if there is none. Without agent the recording is played as it was.
+std::shared_ptr<pod_game> resimulate(const pod_replay &r, agent_ptr agent = 0, int swap_team = 0, int swap_turn = 0,
+                                     agent_ptr fallback = 0);
+
+// true if the game ended in the recorded final state
+bool matches_recording(const pod_replay &r, std::shared_ptr<pod_game> g);
@@ -4,6 +4,7 @@
 #include <cassert>
 #include <cmath>
 #include <iostream>
+#include <set>
 #include <sstream>
 #include <string>
 
@@ -11,6 +12,7 @@
 #include "evaluator.hpp"
 #include "game.hpp"
 #include "game_generator.hpp"
+#include "run_log.hpp"
 #include "utility.hpp"
 
 using namespace std;
@@ -55,13 +57,13 @@ void population_manager::deserialize(stringstream &ss) {
   retirement = load_pop(ss);
 }
 
-string population_manager::pop_stats(string row_prefix) const {
-  stringstream ss;
-  string comma = ",";
+vector<log_row> population_manager::pop_stats(const log_row &row_prefix) const {
+  vector<log_row> rows(pop.size(), row_prefix);
   for (int i = 0; i < pop.size(); i++) {
-    ss << row_prefix << comma << (i + 1) << comma << pop[i]->status_report() << endl;
+    rows[i].i64(i + 1);
+    pop[i]->status_report(rows[i]);
   }
-  return ss.str();
+  return rows;
 }
 
 vector<agent_ptr> population_manager::topn(int n) const {
@@ -118,6 +120,24 @@ void population_manager::sortpop() {
   for (int i = 0; i < pop.size(); i++) pop[i]->rank = i + 1;
 }
 
+// replace the lowest ranked agents with immigrants, keeping at least half of the residents
+void population_manager::immigrate(vector<agent_ptr> buf) {
+  set<int> ids;
+  for (auto a : pop) ids.insert(a->id);
+
+  // agents returning to their home island may still be alive here
+  vector<agent_ptr> fresh;
+  for (auto a : buf) {
+    if (!ids.count(a->id)) fresh.push_back(a);
+  }
+
+  int n = min<int>(fresh.size(), popsize / 2);
+  sortpop();
+  if (pop.size() > popsize - n) pop.resize(popsize - n);
+  pop.insert(pop.end(), fresh.begin(), fresh.begin() + n);
+  sortpop();
+}
+
 void population_manager::evolve(game_generator_ptr gg) {
   check_gg(gg);
 
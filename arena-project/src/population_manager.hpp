@@ -17,12 +17,14 @@ class population_manager {
   agent_ptr refbot;
 
   population_manager(int popsize, agent_f gen, float plim);
-  std::string pop_stats(std::string row_prefix) const;
+  // one row per agent in rank order, the fields of row_prefix followed by the rank and the agent's status report
+  std::vector<log_row> pop_stats(const log_row &row_prefix) const;
   std::vector<agent_ptr> topn(int n) const;
   void check_gg(game_generator_ptr gg) const;
   std::string serialize() const;
   void deserialize(std::stringstream &ss);
   void sortpop();
+  void immigrate(std::vector<agent_ptr> buf);
 
   virtual void prepare_epoch(int epoch, game_generator_ptr ggen);
   virtual void evolve(game_generator_ptr ggen);
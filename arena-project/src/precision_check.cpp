@@ -0,0 +1,148 @@
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "agent.hpp"
+#include "evaluator.hpp"
+#include "pod_agent.hpp"
+#include "pod_game_generator.hpp"
+#include "simple_pod_evaluator.hpp"
+#include "team_evaluator.hpp"
+#include "tree_evaluator.hpp"
+#include "utility.hpp"
+
+using namespace std;
+
+// Compare single and double precision decisions of agents on sampled game states
+
+struct precision_stats {
+  int samples;
+  int divergent;
+  double max_abs_diff;
+  double sum_abs_diff;
+  double max_rel_diff;
+
+  precision_stats() {
+    samples = 0;
+    divergent = 0;
+    max_abs_diff = 0;
+    sum_abs_diff = 0;
+    max_rel_diff = 0;
+  }
+};
+
+agent_ptr refbot_gen() {
+  agent_ptr a(new pod_agent);
+  a->eval = evaluator_ptr(new simple_pod_evaluator);
+  a->label = "simple-pod";
+  return a;
+}
+
+precision_stats check_agent(agent_ptr a, const vector<record> &samples) {
+  precision_stats res;
+
+  for (auto &r : samples) {
+    int n = r.opts.size();
+    dvec yd(n);
+    vec yf(n);
+
+    for (int i = 0; i < n; i++) {
+      yd[i] = a->eval->evaluate_double(type_shift<scalar, double>(r.opts[i].input));
+      yf[i] = a->eval->evaluate_float(type_shift<scalar, float>(r.opts[i].input));
+
+      double diff = fabs(yd[i] - yf[i]);
+      res.sum_abs_diff += diff;
+      res.max_abs_diff = fmax(res.max_abs_diff, diff);
+      if (yd[i] != 0) res.max_rel_diff = fmax(res.max_rel_diff, diff / fabs(yd[i]));
+    }
+
+    int idx_double = max_idx(type_shift<double, scalar>(yd));
+    int idx_float = max_idx(yf);
+    res.divergent += idx_double != idx_float;
+    res.samples++;
+  }
+
+  return res;
+}
+
+int main(int argc, char **argv) {
+  int nsamples = 1000;
+  int nagents = 10;
+  int ppt = 2;
+  vector<string> loadfiles;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "n")) {
+      nsamples = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "agents")) {
+      nagents = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "ppt")) {
+      ppt = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "load")) {
+      loadfiles.push_back(argv[++i]);
+    }
+  }
+
+  pod_game_generator ggen(2, ppt, refbot_gen);
+  input_sampler isam = ggen.generate_input_sampler();
+  int cdim = ggen.choice_dim();
+  set<int> ireq = ggen.required_inputs();
+
+  vector<agent_ptr> agents;
+  for (auto f : loadfiles) {
+    ifstream fin(f);
+    stringstream ss;
+    ss << fin.rdbuf();
+    agents.push_back(deserialize_agent(ss));
+  }
+
+  if (loadfiles.empty()) {
+    for (int i = 0; i < nagents; i++) {
+      agent_ptr a(new pod_agent);
+      vector<evaluator_ptr> evals;
+      for (int j = 0; j < ppt; j++) evals.push_back(tree_evaluator::ptr(new tree_evaluator));
+      a->eval = team_evaluator::ptr(new team_evaluator(evals, 4));
+      a->label = "tree-pod";
+      a->initialize_from_input(isam, cdim, ireq);
+      agents.push_back(a);
+    }
+  }
+
+  vector<record> samples = vec_replicate(isam, nsamples);
+
+  cout << "agent,complexity,samples,divergent,divergence_rate,max_abs_diff,mean_abs_diff,max_rel_diff" << endl;
+  precision_stats total;
+  int nopts = 0;
+  for (auto &r : samples) nopts += r.opts.size();
+
+  for (auto a : agents) {
+    precision_stats s = check_agent(a, samples);
+
+    cout << a->id << comma
+         << a->eval->complexity() << comma
+         << s.samples << comma
+         << s.divergent << comma
+         << s.divergent / (double)s.samples << comma
+         << s.max_abs_diff << comma
+         << s.sum_abs_diff / nopts << comma
+         << s.max_rel_diff << endl;
+
+    total.samples += s.samples;
+    total.divergent += s.divergent;
+    total.sum_abs_diff += s.sum_abs_diff;
+    total.max_abs_diff = fmax(total.max_abs_diff, s.max_abs_diff);
+    total.max_rel_diff = fmax(total.max_rel_diff, s.max_rel_diff);
+  }
+
+  cout << "total" << comma
+       << "" << comma
+       << total.samples << comma
+       << total.divergent << comma
+       << total.divergent / (double)total.samples << comma
+       << total.max_abs_diff << comma
+       << total.sum_abs_diff / ((double)nopts * agents.size()) << comma
+       << total.max_rel_diff << endl;
+
+  return 0;
+}
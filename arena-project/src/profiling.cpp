@@ -0,0 +1,117 @@
+#include "profiling.hpp"
+
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <vector>
+
+#include "utility.hpp"
+
+using namespace std;
+
+namespace profiling {
+typedef totals thread_buffer;
+
+// buffers are never freed so counts from finished threads are kept until the next row
+vector<thread_buffer *> &registry() {
+  static vector<thread_buffer *> buffers;
+  return buffers;
+}
+
+MutexType &registry_lock() {
+  static MutexType m;
+  return m;
+}
+
+// returns null while registering, since the registry itself allocates
+thread_buffer *local_buffer() {
+  static thread_local thread_buffer *local = 0;
+  static thread_local bool registering = false;
+
+  if (!local && !registering) {
+    registering = true;
+    thread_buffer *b = (thread_buffer *)calloc(1, sizeof(thread_buffer));
+    registry_lock().Lock();
+    registry().push_back(b);
+    registry_lock().Unlock();
+    local = b;
+    registering = false;
+  }
+
+  return local;
+}
+
+void count(counter c, long n) {
+  thread_buffer *b = local_buffer();
+  if (b) b->counters[c] += n;
+}
+
+void add_time(phase p, double seconds) {
+  thread_buffer *b = local_buffer();
+  if (b) b->times[p] += seconds;
+}
+
+string csv_header() {
+  stringstream ss;
+  ss << "epoch" << comma
+     << "games" << comma
+     << "turns" << comma
+     << "decisions" << comma
+     << "evaluations" << comma
+     << "gradients" << comma
+     << "allocations" << comma
+     << "optim_steps" << comma
+     << "samples" << comma
+     << "t_prepare" << comma
+     << "t_tests" << comma
+     << "t_play" << comma
+     << "t_train" << comma
+     << "t_stats" << comma
+     << "t_evolve" << endl;
+  return ss.str();
+}
+
+totals collect(bool reset) {
+  totals res = totals();
+
+  registry_lock().Lock();
+  for (auto b : registry()) {
+    for (int i = 0; i < PC_NUM; i++) res.counters[i] += b->counters[i];
+    for (int i = 0; i < PP_NUM; i++) res.times[i] += b->times[i];
+    if (reset) *b = thread_buffer();
+  }
+  registry_lock().Unlock();
+
+  return res;
+}
+
+string epoch_row(unsigned int epoch) {
+  totals res = collect();
+
+  stringstream ss;
+  ss << epoch;
+  for (int i = 0; i < PC_NUM; i++) ss << comma << res.counters[i];
+  for (int i = 0; i < PP_NUM; i++) ss << comma << res.times[i];
+  ss << endl;
+  return ss.str();
+}
+
+scoped_timer::scoped_timer(phase p) : p(p), start(chrono::steady_clock::now()) {}
+
+scoped_timer::~scoped_timer() {
+  add_time(p, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+}
+};  // namespace profiling
+
+#ifdef ENABLE_PROFILING
+// count heap allocations per thread
+void *operator new(size_t size) {
+  profiling::count(profiling::PC_ALLOCATIONS);
+  void *p = malloc(size ? size : 1);
+  if (!p) throw bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t size) noexcept { free(p); }
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+// Lightweight counters and phase timers. Each thread writes to its own
+// buffer, buffers are summed and reset once per epoch by the arena.
+namespace profiling {
+enum counter {
+  PC_GAMES,
+  PC_TURNS,
+  PC_DECISIONS,
+  PC_EVALUATIONS,
+  PC_GRADIENTS,
+  PC_ALLOCATIONS,  // only counted when built with ENABLE_PROFILING (make PROFILING=1)
+  PC_OPTIM_STEPS,
+  PC_SAMPLES,
+  PC_NUM
+};
+
+enum phase {
+  PP_PREPARE,
+  PP_TESTS,
+  PP_PLAY,
+  PP_TRAIN,
+  PP_STATS,
+  PP_EVOLVE,
+  PP_NUM
+};
+
+struct totals {
+  long counters[PC_NUM];
+  double times[PP_NUM];
+};
+
+void count(counter c, long n = 1);
+void add_time(phase p, double seconds);
+
+// sum of all thread buffers, optionally resetting them
+totals collect(bool reset = true);
+
+// csv header and one row summing all thread buffers since the last row
+std::string csv_header();
+std::string epoch_row(unsigned int epoch);
+
+// adds the time from construction to destruction to a phase
+struct scoped_timer {
+  phase p;
+  std::chrono::steady_clock::time_point start;
+
+  scoped_timer(phase p);
+  ~scoped_timer();
+};
+};  // namespace profiling
@@ -7,12 +7,15 @@
 #include <fstream>
 #include <iostream>
 
+#include "async_io.hpp"
 #include "game_generator.hpp"
 #include "pod_game.hpp"
 #include "pod_game_generator.hpp"
 #include "population_manager.hpp"
+#include "run_log.hpp"
 #include "simple_pod_evaluator.hpp"
 #include "team_evaluator.hpp"
+#include "trace.hpp"
 #include "tree_evaluator.hpp"
 #include "utility.hpp"
 
@@ -113,7 +116,7 @@ void pure_train(int n) {
     cout << "Select starting point..." << endl;
     vec w(nw, 0);
     do {
-      ep->set_weights(w = vec_replicate<double>(bind(&rnorm, 0, 2), nw));
+      ep->set_weights(w = vec_replicate<scalar>(bind(&rnorm, 0, 2), nw));
     } while (l2norm(ep->fgrad(w, recs0, a)) < 1);
 
     // TODO: seems constant 0 is always a tempting local optimum...
@@ -200,23 +203,20 @@ void pure_train(int n) {
 
   cout << "Accepted " << agents_accepted << " of " << (agents_accepted + agents_discarded) << " init agents." << endl;
 
-  omp_lock_t writelock;
-  omp_init_lock(&writelock);
-
-  string fname = "data/pure-train-run-" + to_string(run_id) + ".csv";
+  run_log stats_log("data/pure-train-run-" + to_string(run_id) + ".rlog", {"epoch", "supervision", "reinforcement"});
   int batch_size;
 
   for (int epoch = 1; pop.size() > 1; epoch++) {
     batch_size = ceil(sqrt(epoch));
     cout << "Pure train: epoch " << epoch << ": batch size " << batch_size << ", " << pop.size() << " agents remaining" << endl;
-
-    stringstream ss;
+    trace::set_epoch(epoch);
 
     counter = 0;
 #pragma omp parallel for
     for (int i = 0; i < pop.size(); i++) {
       agent_ptr a = pop[i];
       if (!a->eval->stable) continue;
+      TRACE_SPAN("pure_train", a->id);
       a->set_exploration_rate(0.5 - 0.4 * psigmoid(a->score_simple.value_ma - 1, 0.3));
 
       double win_buf = 0;
@@ -253,11 +253,11 @@ void pure_train(int n) {
 
       a->train(training_data, isam);
 
-      omp_set_lock(&writelock);
-      int sup = (training_types[i] & SUPERVISION) > 0;
-      int rfm = (training_types[i] & REINFORCEMENT) > 0;
-      ss << epoch << comma << sup << comma << rfm << comma << a->status_report() << endl;
-      omp_unset_lock(&writelock);
+      // built outside of any lock, the log only locks to collect the row
+      log_row row;
+      row.i64(epoch).i64((training_types[i] & SUPERVISION) > 0).i64((training_types[i] & REINFORCEMENT) > 0);
+      a->status_report(row);
+      stats_log.append(move(row));
 
       counter++;
       cout << ((100 * counter) / pop.size()) << "% done\r" << flush;
@@ -267,9 +267,9 @@ void pure_train(int n) {
 
     cout << "Writing stats and cleaning up" << endl;
 
-    ofstream fmeta(fname, ios::app);
-    fmeta << ss.str();
-    fmeta.close();
+    stats_log.flush();
+    cout << "Pure train: " << async_io::status() << endl;
+    trace::flush();
 
     for (int i = 0; i < pop.size(); i++) {
       if (!pop[i]->eval->stable || (pop[i]->tstats.rate_successfull < 0.1 && pop[i]->age > 2)) {
@@ -279,8 +279,6 @@ void pure_train(int n) {
       }
     }
   }
-
-  omp_destroy_lock(&writelock);
 }
 
 int main(int argc, char** argv) {
@@ -288,6 +286,8 @@ int main(int argc, char** argv) {
   for (int i = 1; i < argc; i++) {
     if (!strcmp(argv[i], "n")) {
       n = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "trace")) {
+      trace::start(argv[++i]);
     }
   }
 
@@ -5,14 +5,101 @@
 #include <iostream>
 
 #include "agent.hpp"
+#include "evaluator.hpp"
 #include "game.hpp"
+#include "game_worker.hpp"
+#include "profiling.hpp"
+#include "trace.hpp"
 #include "game_generator.hpp"
 #include "population_manager.hpp"
 #include "utility.hpp"
 
 using namespace std;
 
-random_tournament::random_tournament(int gr) : tournament(), game_rounds(gr) {}
+random_tournament::random_tournament(int gr, bool ls, shared_ptr<game_worker_pool> w) : tournament(), game_rounds(gr), lockstep(ls), workers(w) {}
+
+// evaluation requests from all games in a turn that share an evaluator
+struct eval_group {
+  evaluator_ptr eval;
+  std::vector<const vec *> inputs;
+  std::vector<scalar *> outputs;
+};
+
+// advance all games one turn at a time, evaluating all options for each evaluator in one batch
+void random_tournament::play_lockstep(vector<game_ptr> games, int epoch) {
+  vector<game_ptr> active;
+
+  for (auto g : games) {
+    g->turns_played = 0;
+    g->result_buf.clear();
+    if (g->turns_remaining()) active.push_back(g);
+  }
+
+  while (active.size()) {
+    TRACE_SPAN("lockstep_turn");
+    vector<record_table> turn(active.size());
+
+#pragma omp parallel for
+    for (int k = 0; k < active.size(); k++) turn[k] = active[k]->prepare_turn();
+
+    // group requests by evaluator, clones playing for the same original agent share its evaluator
+    hm<evaluator *, int> group_idx;
+    vector<eval_group> groups;
+    for (int k = 0; k < active.size(); k++) {
+      game_ptr g = active[k];
+      for (auto &x : turn[k]) {
+        agent_ptr p = g->players.at(x.first);
+        evaluator_ptr e = p->eval;
+        for (auto a : g->original_agents) {
+          if (a->team == p->team) e = a->eval;
+        }
+
+        if (!group_idx.count(e.get())) {
+          group_idx[e.get()] = groups.size();
+          groups.push_back(eval_group());
+          groups.back().eval = e;
+        }
+
+        eval_group &eg = groups[group_idx[e.get()]];
+        for (auto &o : x.second.opts) {
+          eg.inputs.push_back(&o.input);
+          eg.outputs.push_back(&o.output);
+        }
+      }
+    }
+
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < groups.size(); i++) {
+      eval_group &eg = groups[i];
+      profiling::count(profiling::PC_EVALUATIONS, eg.inputs.size());
+      vec buf(eg.inputs.size());
+      eg.eval->evaluate_batch(eg.inputs, buf.data());
+      for (int j = 0; j < buf.size(); j++) *eg.outputs[j] = buf[j];
+    }
+
+#pragma omp parallel for
+    for (int k = 0; k < active.size(); k++) {
+      game_ptr g = active[k];
+      for (auto &x : turn[k]) g->players.at(x.first)->finalize_choice(x.second);
+
+      record_table rect = g->apply_turn(turn[k]);
+      for (auto x : rect) g->result_buf[x.first].push_back(x.second);
+      g->turns_played++;
+      profiling::count(profiling::PC_TURNS);
+    }
+
+    vector<game_ptr> buf;
+    for (auto g : active) {
+      if (g->turns_remaining()) {
+        buf.push_back(g);
+      } else {
+        g->add_winner_reward(g->result_buf, epoch);
+        profiling::count(profiling::PC_GAMES);
+      }
+    }
+    active = buf;
+  }
+}
 
 void random_tournament::run(population_manager_ptr pm, game_generator_ptr gg, int epoch) {
   int practice_rounds = 0.3 * game_rounds;
@@ -51,8 +138,17 @@ void random_tournament::run(population_manager_ptr pm, game_generator_ptr gg, in
       game_record[idx]->original_agents = assign_players;
     }
 
+    {
+      profiling::scoped_timer t(profiling::PP_PLAY);
+      if (workers && workers->live_workers()) {
+        workers->play(game_record, epoch);
+      } else if (lockstep) {
+        play_lockstep(game_record, epoch);
+      } else {
 #pragma omp parallel for
-    for (int i = 0; i < game_record.size(); i++) game_record[i]->result_buf = game_record[i]->play(epoch);
+        for (int i = 0; i < game_record.size(); i++) game_record[i]->result_buf = game_record[i]->play(epoch);
+      }
+    }
 
     // update scores
     for (int i = 0; i < pm->pop.size(); i++) {
@@ -108,6 +204,7 @@ void random_tournament::run(population_manager_ptr pm, game_generator_ptr gg, in
     if (round % batch_size == 0 || round == game_rounds - 1) {
       cout << endl
            << "RT: training batch" << endl;
+      profiling::scoped_timer t(profiling::PP_TRAIN);
 #pragma omp parallel for
       for (int i = 0; i < pm->pop.size(); i++) {
         pm->pop[i]->train(training_data[i], isam);
@@ -1,12 +1,20 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include "tournament.hpp"
 
+class game_worker_pool;
+
 // tournament where each player plays one random game
 class random_tournament : public tournament {
   int game_rounds;
+  bool lockstep;
+  std::shared_ptr<game_worker_pool> workers;
 
  public:
-  random_tournament(int gr = 100);
+  random_tournament(int gr = 100, bool lockstep = false, std::shared_ptr<game_worker_pool> workers = 0);
   void run(population_manager_ptr pm, game_generator_ptr gg, int epoch);
+  void play_lockstep(std::vector<game_ptr> games, int epoch);
 };
\ No newline at end of file
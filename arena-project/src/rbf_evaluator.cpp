@@ -0,0 +1,398 @@
+#include "rbf_evaluator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "agent.hpp"
+#include "run_log.hpp"
+#include "utility.hpp"
+
+using namespace std;
+
+const int leaf_size = 8;
+
+rbf_evaluator::rbf_evaluator() : evaluator() {
+  tag = "rbf";
+  choice_dim = 0;
+  bw_state = 1;
+  bw_choice = 1;
+  cluster_rate = 0.5;
+  alpha = 0.1;
+  knn = 8;
+  max_checks = 8;
+  max_bases = 400;
+}
+
+// standardize and divide by the bandwidth, the 1/sqrt(dim) keeps the kernel width independent of the input dimension
+void rbf_evaluator::scale_input(const vec &x, scalar *p) const {
+  double norm = 1 / sqrt((double)dim);
+  for (int d = 0; d < dim; d++) {
+    double bw = d < choice_dim ? bw_choice : bw_state;
+    p[d] = (x[d] - x_mean[d]) / (x_std[d] * bw) * norm;
+  }
+}
+
+// best first search for the knn nearest bases, stops after max_checks leaves. Writes (squared distance, base index)
+// sorted by distance and returns the number found.
+int rbf_evaluator::nearest(const scalar *p, neighbor *out) const {
+  if (bases.empty()) return 0;
+
+  // (lower bound on the distance, node)
+  thread_local vector<neighbor> open;
+  open.clear();
+  open.push_back({0, 0});
+
+  int count = 0;
+  int checks = 0;
+  while (!open.empty() && checks < max_checks) {
+    pop_heap(open.begin(), open.end(), greater<neighbor>());
+    auto [bound, node] = open.back();
+    open.pop_back();
+    if (count == knn && bound >= out[count - 1].first) break;
+
+    // descend to the near leaf, queueing the far sides
+    while (nodes[node].split >= 0) {
+      const kd_node &x = nodes[node];
+      scalar diff = p[x.split] - x.value;
+      open.push_back({max<scalar>(bound, diff * diff), x.child[diff < 0]});
+      push_heap(open.begin(), open.end(), greater<neighbor>());
+      node = x.child[diff >= 0];
+    }
+
+    for (int i : nodes[node].items) {
+      const scalar *b = &points[i * dim];
+      scalar d2 = 0;
+      for (int d = 0; d < dim; d++) d2 += (p[d] - b[d]) * (p[d] - b[d]);
+
+      int pos;
+      if (count < knn) {
+        pos = count++;
+      } else if (d2 < out[knn - 1].first) {
+        pos = knn - 1;
+      } else {
+        continue;
+      }
+      for (; pos > 0 && out[pos - 1].first > d2; pos--) out[pos] = out[pos - 1];
+      out[pos] = {d2, i};
+    }
+    checks++;
+  }
+
+  return count;
+}
+
+// kernel weighted mean of the neighbor values, w is set to the normalized weights. Weights are taken relative to the
+// nearest neighbor so inputs far from all bases still get the value of the nearest ones.
+scalar rbf_evaluator::kernel_mean(const neighbor *nn, int k, vec &w) const {
+  w.resize(k);
+  double wsum = 0, y = 0;
+  for (int j = 0; j < k; j++) {
+    w[j] = exp(nn[0].first - nn[j].first);
+    wsum += w[j];
+    y += w[j] * bases[nn[j].second].q;
+  }
+  for (auto &x : w) x /= wsum;
+  return y / wsum;
+}
+
+scalar rbf_evaluator::evaluate(vec x) {
+  thread_local vec p, w;
+  thread_local vector<neighbor> nn;
+  p.resize(dim);
+  nn.resize(knn);
+
+  scale_input(x, p.data());
+  int k = nearest(p.data(), nn.data());
+  if (k == 0) return 0;
+  return kernel_mean(nn.data(), k, w);
+}
+
+// Move the values of the neighbors of each selected option towards its future rewards, or start a new base where
+// there are no close neighbors
+evaluator_ptr rbf_evaluator::update(vector<record> records, agent_ptr a, double &rel_change) const {
+  rbf_evaluator::ptr buf = static_pointer_cast<rbf_evaluator>(clone());
+  rel_change = 0;
+  if (records.empty()) return buf;
+
+  vec p(dim), w;
+  vector<neighbor> nn(knn);
+  double dq2 = 0, y2 = 0;
+  for (auto &r : records) {
+    const option &o = r.opts[r.selected_option];
+    scalar target = r.sum_future_rewards;
+
+    buf->scale_input(o.input, p.data());
+    int k = buf->nearest(p.data(), nn.data());
+    if (k == 0 || exp(-nn[0].first) < cluster_rate) {
+      buf->add_base(o.input, target);
+      dq2 += target * target;
+      continue;
+    }
+
+    scalar y = buf->kernel_mean(nn.data(), k, w);
+    for (int j = 0; j < k; j++) {
+      rbf_base &b = buf->bases[nn[j].second];
+      scalar dq = alpha * w[j] * (target - y);
+      b.q += dq;
+      b.n += w[j];
+      dq2 += dq * dq;
+    }
+    y2 += y * y;
+  }
+
+  rel_change = sqrt(dq2 / fmax(y2, 1e-12));
+  if (!isfinite(rel_change)) return NULL;
+
+  buf->prune();
+  return buf;
+}
+
+// drop bases with kernel mass below limit times the largest, and the least used ones beyond max_bases
+void rbf_evaluator::prune(double limit) {
+  if (bases.empty()) return;
+
+  double nmax = 0;
+  for (auto &b : bases) nmax = fmax(nmax, b.n);
+
+  // the index refers to bases by position, so it is rebuilt whenever they are reordered or dropped
+  bool changed = false;
+  if ((int)bases.size() > max_bases) {
+    sort(bases.begin(), bases.end(), [](const rbf_base &a, const rbf_base &b) { return a.n > b.n; });
+    bases.resize(max_bases * 4 / 5);
+    changed = true;
+  }
+
+  vector<rbf_base> keep;
+  for (auto &b : bases) {
+    if (b.n >= limit * nmax) keep.push_back(b);
+  }
+  if (keep.size() < bases.size()) {
+    bases = keep;
+    changed = true;
+  }
+
+  if (changed) rebuild_index();
+}
+
+evaluator_ptr rbf_evaluator::mate(evaluator_ptr partner_buf) const {
+  rbf_evaluator::ptr partner = static_pointer_cast<rbf_evaluator>(partner_buf);
+  rbf_evaluator::ptr child = static_pointer_cast<rbf_evaluator>(clone());
+  child->bw_state = 0.5 * (bw_state + partner->bw_state);
+  child->bw_choice = 0.5 * (bw_choice + partner->bw_choice);
+  child->cluster_rate = 0.5 * (cluster_rate + partner->cluster_rate);
+  child->alpha = 0.5 * (alpha + partner->alpha);
+  child->rebuild_index();
+
+  for (auto &b : partner->bases) {
+    if (u01() < 0.3) child->add_base(b.x, b.q);
+  }
+
+  return child;
+}
+
+evaluator_ptr rbf_evaluator::mutate(evaluator::dist_category dc) const {
+  if (dc == MUT_RANDOM) dc = sample_one<dist_category>({MUT_SMALL, MUT_MEDIUM, MUT_LARGE});
+  rbf_evaluator::ptr child = static_pointer_cast<rbf_evaluator>(clone());
+
+  vector<double> spread = {1e-3, 1e-2, 1e-1};
+  child->bw_state = fmax(bw_state * rnorm(1, spread[dc]), 0.01);
+  child->bw_choice = fmax(bw_choice * rnorm(1, spread[dc]), 0.01);
+  child->cluster_rate = fmin(fmax(cluster_rate + rnorm(0, spread[dc]), 0.01), 0.99);
+  child->alpha = fmin(fmax(alpha * rnorm(1, spread[dc]), 1e-3), 1);
+  for (auto &b : child->bases) b.q += rnorm(0, spread[dc]);
+  child->rebuild_index();
+  child->mut_tag = dc;
+  return child;
+}
+
+string rbf_evaluator::serialize() const {
+  stringstream ss;
+  ss << evaluator::serialize() << sep << choice_dim << sep << bw_state << sep << bw_choice << sep << cluster_rate
+     << sep << alpha << sep << knn << sep << max_checks << sep << max_bases << sep << x_mean << sep << x_std << sep
+     << bases.size();
+  for (auto &b : bases) ss << sep << b.q << sep << b.n << sep << b.x;
+  return ss.str();
+}
+
+void rbf_evaluator::deserialize(stringstream &ss) {
+  evaluator::deserialize(ss);
+  int n;
+  ss >> choice_dim >> bw_state >> bw_choice >> cluster_rate >> alpha >> knn >> max_checks >> max_bases >> x_mean >> x_std >> n;
+
+  bases.resize(n);
+  for (auto &b : bases) ss >> b.q >> b.n >> b.x;
+  rebuild_index();
+}
+
+void rbf_evaluator::initialize(input_sampler sampler, int cdim, set<int> ireq) {
+  stable = true;
+  dim = cdim;
+  bw_state = u01(0.1, 0.5);
+  bw_choice = u01(0.1, 0.5);
+  cluster_rate = u01(0.2, 0.6);
+  alpha = u01(0.05, 0.3);
+
+  // input scale from sampled options
+  vector<record> samples;
+  for (int i = 0; i < 100; i++) samples.push_back(sampler());
+  choice_dim = samples.front().opts.front().choice.size();
+
+  x_mean = vec(dim, 0);
+  x_std = vec(dim, 0);
+  int n = 0;
+  for (auto &r : samples) {
+    for (auto &o : r.opts) {
+      for (int d = 0; d < dim; d++) x_mean[d] += o.input[d];
+      n++;
+    }
+  }
+  for (auto &x : x_mean) x /= n;
+  for (auto &r : samples) {
+    for (auto &o : r.opts) {
+      for (int d = 0; d < dim; d++) x_std[d] += pow(o.input[d] - x_mean[d], 2);
+    }
+  }
+  for (auto &x : x_std) x = x > 0 ? sqrt(x / n) : 1;
+
+  // a few bases with small random values at sampled selected options
+  bases.clear();
+  rebuild_index();
+  for (int i = 0; i < 2 * knn; i++) {
+    record r = sample_one(samples);
+    add_base(r.opts[r.selected_option].input, rnorm(0, 0.1));
+  }
+}
+
+void rbf_evaluator::status_report(log_row &row) const {
+  row.f64(bw_state).f64(bw_choice).f64(complexity());
+}
+
+evaluator_ptr rbf_evaluator::clone() const {
+  return rbf_evaluator::ptr(new rbf_evaluator(*this));
+}
+
+double rbf_evaluator::complexity() const { return bases.size(); }
+
+// every base uses the full input
+set<int> rbf_evaluator::list_inputs() const {
+  set<int> res;
+  for (int i = 0; i < dim; i++) res.insert(i);
+  return res;
+}
+
+void rbf_evaluator::add_inputs(set<int> inputs) {}
+
+void rbf_evaluator::set_weights(const vec &x) {
+  for (int i = 0; i < bases.size(); i++) bases[i].q = x[i];
+}
+
+vec rbf_evaluator::get_weights() const {
+  vec x(bases.size());
+  for (int i = 0; i < bases.size(); i++) x[i] = bases[i].q;
+  return x;
+}
+
+// gradient of the squared error wrt base values, only the neighbors of the input are non zero
+vec rbf_evaluator::gradient(vec input, scalar target) const {
+  vec g(bases.size(), 0), p(dim), w;
+  vector<neighbor> nn(knn);
+  scale_input(input, p.data());
+  int k = nearest(p.data(), nn.data());
+  if (k == 0) return g;
+
+  scalar y = kernel_mean(nn.data(), k, w);
+  for (int j = 0; j < k; j++) g[nn[j].second] = 2 * (y - target) * w[j];
+  return g;
+}
+
+// Insert a base into the leaf its point falls in, splitting the leaf when it is full. The whole index is rebuilt when
+// a leaf ends up much deeper than a balanced tree would have it.
+void rbf_evaluator::add_base(const vec &x, scalar q) {
+  if (nodes.empty()) rebuild_index();
+  int i = bases.size();
+  bases.push_back({x, q, 1});
+  points.resize(bases.size() * dim);
+  scale_input(x, &points[i * dim]);
+
+  int node = 0, depth = 0;
+  while (nodes[node].split >= 0) {
+    node = nodes[node].child[points[i * dim + nodes[node].split] >= nodes[node].value];
+    depth++;
+  }
+  nodes[node].items.push_back(i);
+
+  if (depth > 2 * log2(bases.size() / leaf_size + 1) + 4) {
+    rebuild_index();
+  } else if (nodes[node].items.size() > 2 * leaf_size) {
+    split_leaf(node);
+  }
+}
+
+void rbf_evaluator::rebuild_index() {
+  points.resize(bases.size() * dim);
+  for (int i = 0; i < bases.size(); i++) scale_input(bases[i].x, &points[i * dim]);
+
+  vector<int> items(bases.size());
+  for (int i = 0; i < items.size(); i++) items[i] = i;
+  nodes.assign(1, kd_node());
+  build_node(0, items);
+}
+
+void rbf_evaluator::split_leaf(int node) {
+  vector<int> items;
+  swap(items, nodes[node].items);
+  build_node(node, items);
+}
+
+// split at the median of the dimension with the widest spread, down to leaves of at most leaf_size bases
+void rbf_evaluator::build_node(int node, vector<int> &items) {
+  nodes[node].split = -1;
+  int s = items.size() > leaf_size ? widest_dim(items) : -1;
+  if (s < 0) {
+    nodes[node].items = items;
+    return;
+  }
+
+  auto coord = [this, s](int i) { return points[i * dim + s]; };
+  auto mid = items.begin() + items.size() / 2;
+  nth_element(items.begin(), mid, items.end(), [&](int a, int b) { return coord(a) < coord(b); });
+  scalar median = coord(*mid), value = median;
+  auto lo = partition(items.begin(), items.end(), [&](int i) { return coord(i) < value; });
+  if (lo == items.begin()) {
+    // the median is the smallest value, split above it instead
+    value = coord(*max_element(items.begin(), items.end(), [&](int a, int b) { return coord(a) < coord(b); }));
+    for (int i : items) {
+      if (coord(i) > median) value = min(value, coord(i));
+    }
+    lo = partition(items.begin(), items.end(), [&](int i) { return coord(i) < value; });
+  }
+
+  vector<int> left(items.begin(), lo), right(lo, items.end());
+  int c0 = nodes.size();
+  nodes.resize(c0 + 2);
+  nodes[node].split = s;
+  nodes[node].value = value;
+  nodes[node].child[0] = c0;
+  nodes[node].child[1] = c0 + 1;
+  build_node(c0, left);
+  build_node(c0 + 1, right);
+}
+
+// dimension with the largest spread of the item points, or -1 if they are all equal
+int rbf_evaluator::widest_dim(const vector<int> &items) const {
+  int best = -1;
+  scalar spread = 0;
+  for (int d = 0; d < dim; d++) {
+    scalar lo = points[items[0] * dim + d], hi = lo;
+    for (int i : items) {
+      lo = min(lo, points[i * dim + d]);
+      hi = max(hi, points[i * dim + d]);
+    }
+    if (hi - lo > spread) {
+      spread = hi - lo;
+      best = d;
+    }
+  }
+  return best;
+}
@@ -1,43 +1,73 @@
 #pragma once
 
+#include <memory>
+#include <utility>
+
 #include "evaluator.hpp"
 
+// Radial basis function evaluator: output is the kernel weighted mean of the values of the k bases nearest to the
+// input. Inputs are standardized and scaled by the choice or state bandwidth, so the kernel is exp(-d²). Bases are
+// kept in a KD-tree, neighbors are found best first with a limit on the leaves checked, so evaluate and update cost
+// O(k log n) in the number of bases.
 class rbf_evaluator : public evaluator {
   struct rbf_base {
-    vec x_choice;
-    vec x_state;
-    double q;
+    vec x;     // unscaled input
+    scalar q;  // output value
+    double n;  // kernel mass of the updates it took part in
   };
 
-  struct rbf_stat {
-    vec dc;
-    vec ds;
-    vec wc;
-    vec ws;
-    rbf_stat(int n);
+  // leaves have split < 0 and hold base indices
+  struct kd_node {
+    int split;
+    scalar value;
+    int child[2];
+    std::vector<int> items;
   };
 
+  typedef std::pair<scalar, int> neighbor;
+
   std::vector<rbf_base> bases;
-  vec choice_mean, choice_std, state_mean, state_std;
-  double dq_mean;
-  double dq_std;
+  int choice_dim;
+  vec x_mean, x_std;
   double bw_state;
   double bw_choice;
-  double cluster_rate;
-  double alpha;
+  double cluster_rate;  // start a new base where the nearest one has kernel weight below this
+  double alpha;         // step of the neighbor values towards the target
+  int knn;
+  int max_checks;  // leaves checked per query
+  int max_bases;
+
+  // index over scaled base points, rebuilt from bases
+  vec points;
+  std::vector<kd_node> nodes;
 
  public:
-  double evaluate(vec x);
-  void update(vec input, double output, int age);
-  ptr mate(ptr partner);
-  ptr mutate();
-  std::string serialize();
-  void deserialize(std::stringstream &ss);
-  void initialize(input_sampler sampler, int cdim);
-  std::string status_report();
-  ptr clone();
-
-  vec normchoice(vec x);
-  vec normstate(vec x);
-  rbf_stat base_stats(vec xc, vec xs);
+  typedef std::shared_ptr<rbf_evaluator> ptr;
+
+  rbf_evaluator();
+  scalar evaluate(vec x) override;
+  evaluator_ptr update(std::vector<record> records, agent_ptr a, double &rel_change) const override;
+  void prune(double limit = 0) override;
+  evaluator_ptr mate(evaluator_ptr partner) const override;
+  evaluator_ptr mutate(dist_category dc) const override;
+  std::string serialize() const override;
+  void deserialize(std::stringstream &ss) override;
+  void initialize(input_sampler sampler, int cdim, std::set<int> ireq) override;
+  void status_report(log_row &row) const override;
+  evaluator_ptr clone() const override;
+  double complexity() const override;
+  std::set<int> list_inputs() const override;
+  void add_inputs(std::set<int> inputs) override;
+  void set_weights(const vec &x) override;
+  vec get_weights() const override;
+  vec gradient(vec input, scalar target) const override;
+
+  void scale_input(const vec &x, scalar *p) const;
+  int nearest(const scalar *p, neighbor *out) const;
+  scalar kernel_mean(const neighbor *nn, int k, vec &w) const;
+  void add_base(const vec &x, scalar q);
+  void rebuild_index();
+  void build_node(int node, std::vector<int> &items);
+  void split_leaf(int node);
+  int widest_dim(const std::vector<int> &items) const;
 };
@@ -0,0 +1,153 @@
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "agent.hpp"
+#include "evaluator.hpp"
+#include "pod_agent.hpp"
+#include "pod_game.hpp"
+#include "pod_game_generator.hpp"
+#include "pod_replay.hpp"
+#include "simple_pod_evaluator.hpp"
+#include "utility.hpp"
+
+using namespace std;
+
+// Record pod games and play them back.
+//
+// Usage: replay record [games <n>] [seed <n>] [corpus <dir>]
+//        replay play <file> [times <n>]
+//        replay swap <file> <brain> [team <t>] [from <turn>]
+//        replay bench <brain> [corpus <dir>]
+//
+// record writes refbot games to <dir>/track-<i>.replay (committed in corpus/), which bench uses as a fixed set of
+// tracks: the agent in the brain file drives team 0 on every track from the start, against the recorded refbot
+// choices and a refbot once those run out. play re-simulates a replay at full speed and checks it reproduces the
+// recorded game, swap lets the brain take over a team from a given turn.
+
+agent_ptr refbot_gen() {
+  agent_ptr a(new pod_agent);
+  a->eval = evaluator_ptr(new simple_pod_evaluator);
+  a->label = "simple-pod";
+  return a;
+}
+
+string track_file(string dir, int i) {
+  return dir + "/track-" + to_string(i) + ".replay";
+}
+
+agent_ptr load_agent(string fname) {
+  ifstream f(fname);
+  if (!f) throw runtime_error("replay: failed to read " + fname);
+  stringstream ss;
+  ss << f.rdbuf();
+  agent_ptr a = deserialize_agent(ss);
+  a->set_exploration_rate(0);
+  return a;
+}
+
+// mean simple score of the pods of a team
+double team_speed(shared_ptr<pod_game> g, int team) {
+  vector<int> pids = g->team_clone_ids(team);
+  double s = 0;
+  for (int pid : pids) s += g->score_simple(pid);
+  return s / pids.size();
+}
+
+void report(string name, const pod_replay &r, shared_ptr<pod_game> g) {
+  cout << name << ": " << r.checkpoint.size() << " checkpoints, " << r.run_laps << " laps, recorded " << r.turns()
+       << " turns, winner " << r.winner << "; played " << g->turns_played << " turns, winner " << g->winner
+       << ", speed " << team_speed(g, 0) << " vs " << team_speed(g, 1) << endl;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    cerr << "Usage: replay record|play|swap|bench ..., see src/replay.cpp" << endl;
+    return 1;
+  }
+
+  string cmd = argv[1];
+  vector<string> args;
+  unsigned int seed = 1;
+  int ngames = 20;
+  int times = 1;
+  int team = 0;
+  int from = 0;
+  string corpus = "corpus";
+
+  for (int i = 2; i < argc; i++) {
+    if (!strcmp(argv[i], "seed")) {
+      seed = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "games")) {
+      ngames = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "times")) {
+      times = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "team")) {
+      team = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "from")) {
+      from = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "corpus")) {
+      corpus = argv[++i];
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+
+  seed_random_engine(seed);
+
+  if (cmd == "record") {
+    pod_game_generator ggen(2, 2, refbot_gen);
+    for (int i = 0; i < ngames; i++) {
+      shared_ptr<pod_game> g = static_pointer_cast<pod_game>(ggen.team_bots_vs(refbot_gen()));
+      pod_replay r;
+      g->start_replay(&r);
+      g->play(1);
+      r.save(track_file(corpus, i));
+      report(track_file(corpus, i), r, g);
+    }
+  } else if (cmd == "play" && args.size() == 1) {
+    pod_replay r;
+    r.load(args[0]);
+
+    shared_ptr<pod_game> g;
+    auto t0 = chrono::steady_clock::now();
+    for (int k = 0; k < times; k++) g = resimulate(r);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    report(args[0], r, g);
+    cout << (matches_recording(r, g) ? "matches" : "DIFFERS FROM") << " the recording, " << times * r.turns() / elapsed
+         << " turns/s" << endl;
+    return matches_recording(r, g) ? 0 : 2;
+  } else if (cmd == "swap" && args.size() == 2) {
+    pod_replay r;
+    r.load(args[0]);
+    shared_ptr<pod_game> g = resimulate(r, load_agent(args[1]), team, from, refbot_gen());
+    report(args[0], r, g);
+  } else if (cmd == "bench" && args.size() == 1) {
+    agent_ptr a = load_agent(args[0]);
+    agent_ptr refbot = refbot_gen();
+    refbot->set_exploration_rate(0);
+
+    int n = 0, wins = 0;
+    double speed = 0;
+    for (; ifstream(track_file(corpus, n)).good(); n++) {
+      pod_replay r;
+      r.load(track_file(corpus, n));
+      shared_ptr<pod_game> g = resimulate(r, a, 0, 0, refbot);
+      g->select_winner();
+      wins += g->winner == 0;
+      speed += team_speed(g, 0);
+      report(track_file(corpus, n), r, g);
+    }
+    if (n == 0) throw runtime_error("replay: no tracks in " + corpus + ", run replay record");
+
+    cout << "bench: " << n << " tracks, won " << wins << ", mean speed " << speed / n << endl;
+  } else {
+    cerr << "Usage: replay record|play|swap|bench ..., see src/replay.cpp" << endl;
+    return 1;
+  }
+
+  return 0;
+}
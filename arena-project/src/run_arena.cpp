@@ -1,15 +1,26 @@
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
 #include <cstring>
 #include <fstream>
+#include <thread>
 
 #include "arena.hpp"
 #include "evaluator.hpp"
 #include "game_generator.hpp"
+#include "game_worker.hpp"
+#include "island.hpp"
 #include "pod_game.hpp"
 #include "pod_game_generator.hpp"
 #include "population_manager.hpp"
+#include "profiling.hpp"
 #include "random_tournament.hpp"
+#include "rbf_evaluator.hpp"
 #include "simple_pod_evaluator.hpp"
 #include "team_evaluator.hpp"
+#include "trace.hpp"
 #include "tree_evaluator.hpp"
 
 using namespace std;
@@ -21,6 +32,59 @@ agent_ptr refbot_gen() {
   return a;
 }
 
+struct bench_point {
+  int threads;
+  double wall;
+  long games;
+  long turns;
+  long decisions;
+  long samples;
+  long peak_rss_kb;
+};
+
+// run one bench configuration in a forked process so peak rss and global state are per run
+bench_point fork_bench(int threads, function<void()> run) {
+  bench_point res = {threads, 0, 0, 0, 0, 0, 0};
+  int fd[2];
+  if (pipe(fd)) throw runtime_error("bench: failed to create pipe");
+
+  pid_t pid = fork();
+  if (pid < 0) throw runtime_error("bench: fork failed");
+
+  if (pid == 0) {
+    close(fd[0]);
+    ofstream null_stream;
+    cout.rdbuf(null_stream.rdbuf());
+
+    profiling::collect();
+    auto t0 = chrono::steady_clock::now();
+    run();
+    res.wall = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    profiling::totals tot = profiling::collect();
+    res.games = tot.counters[profiling::PC_GAMES];
+    res.turns = tot.counters[profiling::PC_TURNS];
+    res.decisions = tot.counters[profiling::PC_DECISIONS];
+    res.samples = tot.counters[profiling::PC_SAMPLES];
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    res.peak_rss_kb = usage.ru_maxrss;
+
+    if (write(fd[1], &res, sizeof(res)) != sizeof(res)) _exit(1);
+    close(fd[1]);
+    _exit(0);
+  }
+
+  close(fd[1]);
+  int nread = read(fd[0], &res, sizeof(res));
+  close(fd[0]);
+  waitpid(pid, 0, 0);
+  if (nread != sizeof(res)) throw runtime_error("bench: run with " + to_string(threads) + " threads failed");
+
+  return res;
+}
+
 int main(int argc, char **argv) {
   int threads = 6;
   int ngames = 16;
@@ -32,7 +96,14 @@ int main(int argc, char **argv) {
   int max_turns = 300;
   int game_rounds = 100;
   int max_comp = 800;
-  string loadfile;
+  bool lockstep = false;
+  int nworkers = 0;
+  bool bench = false;
+  bool rbf = false;
+  unsigned int seed = 0;
+  vector<int> sweep;
+  evolution_options opts;
+  island_options iopts;
 
   for (int i = 1; i < argc; i++) {
     if (!strcmp(argv[i], "debug")) {
@@ -51,46 +122,152 @@ int main(int argc, char **argv) {
       max_turns = 100;
       game_rounds = 4;
       max_comp = 400;
+    } else if (!strcmp(argv[i], "bench")) {
+      bench = true;
+      seed = 1;
+      ngames = 4;
+      ppt = 1;
+      preplim = -1;
+      max_turns = 100;
+      game_rounds = 4;
+      max_comp = 400;
+      opts.max_epochs = 2;
+      opts.run_tests = false;
+      opts.write_output = false;
     } else if (!strcmp(argv[i], "threads")) {
       threads = atoi(argv[++i]);
     } else if (!strcmp(argv[i], "ngames")) {
       ngames = atoi(argv[++i]);
     } else if (!strcmp(argv[i], "load")) {
-      loadfile = argv[++i];
+      opts.loadfile = argv[++i];
     } else if (!strcmp(argv[i], "preplim")) {
       preplim = atof(argv[++i]);
     } else if (!strcmp(argv[i], "ppt")) {
       ppt = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "rbf")) {
+      rbf = true;
+    } else if (!strcmp(argv[i], "lockstep")) {
+      lockstep = true;
+    } else if (!strcmp(argv[i], "testmargin")) {
+      opts.test_margin = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "trace")) {
+      trace::start(argv[++i]);
+    } else if (!strcmp(argv[i], "epochs")) {
+      opts.max_epochs = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "seed")) {
+      seed = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "sweep")) {
+      stringstream ss(argv[++i]);
+      string x;
+      while (getline(ss, x, ',')) sweep.push_back(stoi(x));
+    } else if (!strcmp(argv[i], "tests")) {
+      opts.run_tests = true;
+    } else if (!strcmp(argv[i], "output")) {
+      opts.write_output = true;
+    } else if (!strcmp(argv[i], "workers")) {
+      nworkers = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "islands")) {
+      iopts.islands = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "migrate")) {
+      iopts.interval = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "migrants")) {
+      iopts.migrants = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "topology")) {
+      iopts.topology = argv[++i];
     }
   }
 
   // todo: validate ppt matches load file
 
-  game_generator_ptr ggen(new pod_game_generator(tpg, ppt, refbot_gen));
-  ggen->prep_npar = prep_npar;
-  ggen->max_turns = max_turns;
-  ggen->max_complexity = max_comp;
-  set<int> ireq = ggen->required_inputs();
-
-  input_sampler is = ggen->generate_input_sampler();
-  int cdim = ggen->choice_dim();
-
-  agent_f agent_gen = [is, ppt, cdim, ireq]() {
-    agent_ptr a(new pod_agent);
-    vector<evaluator_ptr> evals;
-    for (int i = 0; i < ppt; i++) evals.push_back(tree_evaluator::ptr(new tree_evaluator));
-    a->eval = team_evaluator::ptr(new team_evaluator(evals, 4));
-    a->label = "tree-pod";
-    a->initialize_from_input(is, cdim, ireq);
-    return a;
+  opts.threads = threads;
+
+  auto make_ggen = [&](int npar) {
+    game_generator_ptr ggen(new pod_game_generator(tpg, ppt, refbot_gen));
+    ggen->prep_npar = npar;
+    ggen->max_turns = max_turns;
+    ggen->max_complexity = max_comp;
+    return ggen;
   };
 
-  tournament_ptr t(new random_tournament(game_rounds));
+  auto run = [&](evolution_options ropts) {
+    // fork game workers before anything starts an openmp team
+    game_worker_pool::ptr pool;
+    if (nworkers > 0) pool = game_worker_pool::ptr(new game_worker_pool(nworkers, [&]() { return make_ggen(1); }));
+
+    game_generator_ptr ggen = make_ggen(bench ? ropts.threads : prep_npar);
+    set<int> ireq = ggen->required_inputs();
+
+    input_sampler is = ggen->generate_input_sampler();
+    int cdim = ggen->choice_dim();
 
-  int popsize = ngames * tpg;
-  population_manager_ptr p(new default_population_manager(popsize, agent_gen, preplim));
+    agent_f agent_gen = [is, ppt, cdim, ireq, rbf]() {
+      agent_ptr a(new pod_agent);
+      vector<evaluator_ptr> evals;
+      for (int i = 0; i < ppt; i++) {
+        if (rbf) {
+          evals.push_back(rbf_evaluator::ptr(new rbf_evaluator));
+        } else {
+          evals.push_back(tree_evaluator::ptr(new tree_evaluator));
+        }
+      }
+      a->eval = team_evaluator::ptr(new team_evaluator(evals, 4));
+      a->label = rbf ? "rbf-pod" : "tree-pod";
+      a->initialize_from_input(is, cdim, ireq);
+      return a;
+    };
+
+    tournament_ptr t(new random_tournament(game_rounds, lockstep, pool));
+
+    int popsize = ngames * tpg;
+    population_manager_ptr p(new default_population_manager(popsize, agent_gen, preplim));
+
+    evolution(ggen, t, p, ropts);
+  };
 
-  evolution(ggen, t, p, threads, loadfile);
+  if (iopts.islands > 0) {
+    iopts.seed = seed;
+    island_evolution(iopts, opts, run);
+    return 0;
+  }
+
+  if (!bench) {
+    if (seed) seed_random_engine(seed);
+    run(opts);
+    return 0;
+  }
+
+  // throughput and scaling over a sweep of thread counts
+  if (sweep.empty()) {
+    int hc = max((int)thread::hardware_concurrency(), 1);
+    for (int n = 1; n < hc; n *= 2) sweep.push_back(n);
+    sweep.push_back(hc);
+  }
+
+  // the seeded engine is shared by all OpenMP threads, so with more than one the draws depend on scheduling
+  cerr << "bench: seed " << seed << " only fixes the workload of runs with 1 thread, runs with more threads draw "
+       << "from the shared random engine in scheduling order" << endl;
+  cout << "threads,wall,games_per_sec,turns_per_sec,decisions_per_sec,samples_per_sec,peak_rss_mb,speedup,efficiency" << endl;
+  bench_point base;
+  for (int k = 0; k < sweep.size(); k++) {
+    evolution_options bopts = opts;
+    bopts.threads = sweep[k];
+    bench_point b = fork_bench(sweep[k], [&]() {
+      seed_random_engine(seed);
+      run(bopts);
+    });
+    if (k == 0) base = b;
+
+    double speedup = base.wall / b.wall * base.threads;
+    cout << b.threads << comma
+         << b.wall << comma
+         << b.games / b.wall << comma
+         << b.turns / b.wall << comma
+         << b.decisions / b.wall << comma
+         << b.samples / b.wall << comma
+         << b.peak_rss_kb / 1024.0 << comma
+         << speedup << comma
+         << speedup / b.threads << endl;
+  }
 
   return 0;
 }
@@ -0,0 +1,363 @@
+#include "run_log.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "async_io.hpp"
+
+using namespace std;
+
+const string log_magic = "RUNLOG1\n";
+
+namespace {
+template <typename T>
+void put(string &buf, T x) {
+  buf.append((const char *)&x, sizeof(T));
+}
+
+template <typename T>
+T get(const char *p) {
+  T x;
+  memcpy(&x, p, sizeof(T));
+  return x;
+}
+
+bool parse_i64(const string &s, int64_t &x) {
+  auto res = from_chars(s.data(), s.data() + s.size(), x);
+  return !s.empty() && res.ec == errc() && res.ptr == s.data() + s.size();
+}
+
+bool parse_f64(const string &s, double &x) {
+  if (s.empty()) return false;
+  char *end;
+  x = strtod(s.c_str(), &end);
+  return end == s.c_str() + s.size();
+}
+
+// column of a chunk in the widest type of its fields, an integer column with missing fields is f64 so they can be NaN
+log_type column_type(const vector<log_row> &rows, int c) {
+  log_type t = LOG_I64;
+  for (auto &r : rows) t = max(t, c < r.fields.size() ? r.fields[c].type : LOG_F64);
+  return t;
+}
+
+string field_text(const log_field &f) {
+  if (f.type == LOG_I64) return to_string(f.i);
+  if (f.type == LOG_F64) return format_log_value(f.f);
+  return f.s;
+}
+
+string encode_chunk(const vector<log_row> &rows) {
+  uint32_t ncols = 0;
+  for (auto &r : rows) ncols = max(ncols, (uint32_t)r.fields.size());
+
+  vector<log_type> types(ncols);
+  for (int c = 0; c < ncols; c++) types[c] = column_type(rows, c);
+
+  string payload;
+  for (int c = 0; c < ncols; c++) {
+    if (types[c] == LOG_I64) {
+      for (auto &r : rows) put(payload, r.fields[c].i);
+    } else if (types[c] == LOG_F64) {
+      for (auto &r : rows) {
+        double x = numeric_limits<double>::quiet_NaN();
+        if (c < r.fields.size()) x = r.fields[c].type == LOG_I64 ? r.fields[c].i : r.fields[c].f;
+        put(payload, x);
+      }
+    } else {
+      vector<string> text;
+      text.reserve(rows.size());
+      for (auto &r : rows) text.push_back(c < r.fields.size() ? field_text(r.fields[c]) : "");
+      for (auto &x : text) put(payload, (uint32_t)x.size());
+      for (auto &x : text) payload += x;
+    }
+  }
+
+  string buf;
+  put(buf, log_chunk_magic);
+  put(buf, (uint32_t)rows.size());
+  put(buf, ncols);
+  for (auto t : types) put(buf, (uint8_t)t);
+  put(buf, (uint64_t)payload.size());
+  return buf + payload;
+}
+}  // namespace
+
+string format_log_value(double x) {
+  if (isnan(x)) return "NA";
+  if (isinf(x)) return x > 0 ? "Inf" : "-Inf";
+  char buf[32];
+  auto res = to_chars(buf, buf + sizeof(buf), x);
+  return string(buf, res.ptr);
+}
+
+log_row &log_row::i64(int64_t x) {
+  fields.push_back({LOG_I64, x, 0, ""});
+  return *this;
+}
+
+log_row &log_row::f64(double x) {
+  fields.push_back({LOG_F64, 0, x, ""});
+  return *this;
+}
+
+log_row &log_row::str(string x) {
+  fields.push_back({LOG_STR, 0, 0, move(x)});
+  return *this;
+}
+
+log_row &log_row::csv(const string &text) {
+  size_t a = 0;
+  while (true) {
+    size_t b = text.find(',', a);
+    if (b == string::npos) b = text.size();
+    string s = text.substr(a, b - a);
+    int64_t i;
+    double d;
+    if (parse_i64(s, i)) {
+      i64(i);
+    } else if (parse_f64(s, d)) {
+      f64(d);
+    } else {
+      str(move(s));
+    }
+    if (b == text.size()) break;
+    a = b + 1;
+  }
+  return *this;
+}
+
+run_log::run_log(string path, vector<string> names, int chunk_rows) : path(path), chunk_rows(chunk_rows) {
+  // earlier writes to path may still be queued
+  async_io::drain();
+
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0 && st.st_size > 0) {
+    // drop a chunk left truncated by a crash so the appended ones can be read
+    size_t valid_bytes = run_log_reader(path).valid_bytes;
+    if (valid_bytes < st.st_size && truncate(path.c_str(), valid_bytes) != 0) {
+      throw runtime_error("run_log: failed to truncate " + path);
+    }
+  } else {
+    string header = log_magic;
+    put(header, (uint32_t)names.size());
+    for (auto &n : names) {
+      put(header, (uint32_t)n.size());
+      header += n;
+    }
+    async_io::write(path, move(header), false);
+  }
+}
+
+run_log::~run_log() {
+  flush();
+}
+
+void run_log::append(log_row row) {
+  lock_guard<mutex> guard(lock);
+  append_locked(move(row));
+}
+
+void run_log::append(vector<log_row> new_rows) {
+  lock_guard<mutex> guard(lock);
+  for (auto &r : new_rows) append_locked(move(r));
+}
+
+void run_log::append_csv(const string &text) {
+  // parsed before taking the lock
+  vector<log_row> new_rows;
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t end = text.find('\n', pos);
+    if (end == string::npos) end = text.size();
+    new_rows.emplace_back().csv(text.substr(pos, end - pos));
+    pos = end + 1;
+  }
+  append(move(new_rows));
+}
+
+void run_log::append_locked(log_row &&row) {
+  rows.push_back(move(row));
+  if (rows.size() >= chunk_rows) flush_locked();
+}
+
+void run_log::flush() {
+  lock_guard<mutex> guard(lock);
+  flush_locked();
+}
+
+void run_log::flush_locked() {
+  if (rows.empty()) return;
+  string buf = encode_chunk(rows);
+  rows.clear();
+  async_io::write(path, move(buf));
+}
+
+run_log_reader::run_log_reader(string path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw runtime_error("run_log_reader: failed to open " + path);
+  struct stat st;
+  fstat(fd, &st);
+  size = st.st_size;
+  base = size > 0 ? (const char *)mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0) : 0;
+  close(fd);
+  if (base == MAP_FAILED) throw runtime_error("run_log_reader: failed to map " + path);
+
+  if (size < log_magic.size() + 4 || string(base, log_magic.size()) != log_magic) {
+    if (base) munmap((void *)base, size);
+    throw runtime_error("run_log_reader: " + path + " is not a run log");
+  }
+
+  // header, the names are read only as far as the file goes
+  const char *p = base + log_magic.size(), *end = base + size;
+  uint32_t nnames = get<uint32_t>(p);
+  p += 4;
+  vector<string> names;
+  for (uint32_t i = 0; i < nnames; i++) {
+    uint32_t len = end - p >= 4 ? get<uint32_t>(p) : 0;
+    if (end - p < 4 || end - p - 4 < len) {
+      munmap((void *)base, size);
+      throw runtime_error("run_log_reader: " + path + " has a truncated header");
+    }
+    names.push_back(string(p + 4, len));
+    p += 4 + len;
+  }
+  const char *valid_end = p;
+
+  // chunks, stopping at a truncated one
+  while (end - p >= 12 && get<uint32_t>(p) == log_chunk_magic) {
+    chunk ch;
+    ch.nrows = get<uint32_t>(p + 4);
+    uint32_t ncols = get<uint32_t>(p + 8);
+    if (end - p < 12 + ncols + 8) break;
+    p += 12;
+    for (int c = 0; c < ncols; c++) ch.types.push_back((log_type)p[c]);
+    p += ncols;
+    uint64_t bytes = get<uint64_t>(p);
+    p += 8;
+    if (end - p < bytes) break;
+
+    const char *q = p;
+    for (auto t : ch.types) {
+      ch.data.push_back(q);
+      if (t == LOG_STR) {
+        uint64_t len = 0;
+        for (int r = 0; r < ch.nrows; r++) len += get<uint32_t>(q + 4 * r);
+        q += 4 * ch.nrows + len;
+      } else {
+        q += 8 * ch.nrows;
+      }
+    }
+    p += bytes;
+    valid_end = p;
+
+    for (int c = 0; c < ncols; c++) {
+      if (c >= columns.size()) columns.push_back({c < names.size() ? names[c] : "V" + to_string(c + 1), ch.types[c]});
+      columns[c].type = max(columns[c].type, ch.types[c]);
+    }
+    chunks.push_back(move(ch));
+  }
+  valid_bytes = valid_end - base;
+}
+
+run_log_reader::~run_log_reader() {
+  if (base) munmap((void *)base, size);
+  base = 0;
+}
+
+size_t run_log_reader::rows() const {
+  size_t n = 0;
+  for (auto &ch : chunks) n += ch.nrows;
+  return n;
+}
+
+// field c of row r as text, str_pos walks the bytes of a str column and must start at its first string
+string run_log_reader::field(const chunk &ch, int c, uint32_t r, const char *&str_pos) const {
+  if (c >= ch.types.size()) return "";
+  const char *d = ch.data[c];
+  if (ch.types[c] == LOG_I64) return to_string(get<int64_t>(d + 8 * r));
+  if (ch.types[c] == LOG_F64) return format_log_value(get<double>(d + 8 * r));
+
+  uint32_t len = get<uint32_t>(d + 4 * r);
+  string s(str_pos, len);
+  str_pos += len;
+  return s;
+}
+
+vector<string> run_log_reader::str_column(int c) const {
+  vector<string> res;
+  res.reserve(rows());
+  for (auto &ch : chunks) {
+    const char *str_pos = c < ch.types.size() ? ch.data[c] + 4 * ch.nrows : 0;
+    for (uint32_t r = 0; r < ch.nrows; r++) res.push_back(field(ch, c, r, str_pos));
+  }
+  return res;
+}
+
+vector<double> run_log_reader::f64_column(int c) const {
+  vector<double> res;
+  res.reserve(rows());
+  for (auto &ch : chunks) {
+    const log_type t = c < ch.types.size() ? ch.types[c] : LOG_STR;
+    const char *str_pos = t == LOG_STR && c < ch.types.size() ? ch.data[c] + 4 * ch.nrows : 0;
+    for (uint32_t r = 0; r < ch.nrows; r++) {
+      double x = numeric_limits<double>::quiet_NaN();
+      if (t == LOG_I64) {
+        x = get<int64_t>(ch.data[c] + 8 * r);
+      } else if (t == LOG_F64) {
+        x = get<double>(ch.data[c] + 8 * r);
+      } else if (str_pos) {
+        parse_f64(field(ch, c, r, str_pos), x);
+      }
+      res.push_back(x);
+    }
+  }
+  return res;
+}
+
+vector<int64_t> run_log_reader::i64_column(int c) const {
+  vector<int64_t> res;
+  res.reserve(rows());
+  for (double x : f64_column(c)) res.push_back(isfinite(x) ? (int64_t)x : 0);
+
+  // integer chunks are copied exactly rather than through double
+  size_t offset = 0;
+  for (auto &ch : chunks) {
+    if (c < ch.types.size() && ch.types[c] == LOG_I64) memcpy(&res[offset], ch.data[c], 8 * ch.nrows);
+    offset += ch.nrows;
+  }
+  return res;
+}
+
+void run_log_reader::write_csv(ostream &os, bool header) const {
+  if (header) {
+    for (int c = 0; c < columns.size(); c++) os << (c ? "," : "") << columns[c].name;
+    os << "\n";
+  }
+
+  string line;
+  vector<const char *> str_pos;
+  for (auto &ch : chunks) {
+    str_pos.resize(ch.types.size());
+    for (int c = 0; c < ch.types.size(); c++) str_pos[c] = ch.data[c] + 4 * ch.nrows;
+
+    for (uint32_t r = 0; r < ch.nrows; r++) {
+      line.clear();
+      for (int c = 0; c < columns.size(); c++) {
+        if (c) line += ',';
+        if (c < ch.types.size()) line += field(ch, c, r, str_pos[c]);
+      }
+      line += '\n';
+      os << line;
+    }
+  }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Append-only columnar binary log for run stats, read with run_log_reader or converted to csv with log2csv.
+//
+// A file is a header followed by chunks of rows:
+//   header: "RUNLOG1\n", u32 number of names, then per name u32 length and the bytes
+//   chunk:  u32 log_chunk_magic, u32 nrows, u32 ncols, ncols u8 column types, u64 payload bytes, then the payload
+//           column by column: i64 and f64 columns as nrows values, str columns as nrows u32 lengths and the bytes
+// Rows are given as typed fields, or as csv text whose fields are typed as the narrowest of i64, f64 and str they
+// parse as. A column of a chunk takes the widest type of its fields: integers in an f64 column are converted and
+// numbers in a str column are formatted as text. Rows shorter than the chunk are padded with NaN or "", so the agent
+// rows of different evaluator types can share a log. Full chunks are encoded on the caller's thread and written by
+// the async_io thread, and the reader skips a truncated last chunk left by a crash.
+
+enum log_type : uint8_t {
+  LOG_I64,
+  LOG_F64,
+  LOG_STR
+};
+
+struct log_column {
+  std::string name;
+  log_type type;
+};
+
+const uint32_t log_chunk_magic = 0x4b4e4843;
+
+struct log_field {
+  log_type type;
+  int64_t i;
+  double f;
+  std::string s;
+};
+
+// one row of a run log, built field by field without going through text
+class log_row {
+ public:
+  std::vector<log_field> fields;
+
+  log_row &i64(int64_t x);
+  log_row &f64(double x);
+  log_row &str(std::string x);
+  // comma separated fields, each typed as the narrowest type it parses as
+  log_row &csv(const std::string &text);
+};
+
+class run_log {
+ public:
+  // names label the first columns, the others are named V<i> like read.csv does without a header. If the file exists
+  // the rows are appended to it.
+  run_log(std::string path, std::vector<std::string> names = {}, int chunk_rows = 4096);
+  ~run_log();
+
+  // safe to call from several threads
+  void append(log_row row);
+  void append(std::vector<log_row> rows);
+  // one or more newline terminated rows of comma separated fields
+  void append_csv(const std::string &rows);
+  // hand the collected rows to the I/O thread
+  void flush();
+
+ private:
+  std::string path;
+  int chunk_rows;
+
+  std::mutex lock;
+  std::vector<log_row> rows;
+
+  void append_locked(log_row &&row);
+  void flush_locked();
+};
+
+class run_log_reader {
+ public:
+  // one entry per column of the widest chunk, the type is the widest type the column has in any chunk
+  std::vector<log_column> columns;
+  // size of the header and the complete chunks
+  size_t valid_bytes;
+
+  // maps the file, throws runtime_error if it is not a run log
+  run_log_reader(std::string path);
+  ~run_log_reader();
+
+  size_t rows() const;
+  std::vector<int64_t> i64_column(int c) const;
+  std::vector<double> f64_column(int c) const;
+  std::vector<std::string> str_column(int c) const;
+  void write_csv(std::ostream &os, bool header = false) const;
+
+ private:
+  struct chunk {
+    uint32_t nrows;
+    std::vector<log_type> types;
+    std::vector<const char *> data;  // start of each column
+  };
+
+  const char *base;
+  size_t size;
+  std::vector<chunk> chunks;
+
+  std::string field(const chunk &ch, int c, uint32_t r, const char *&str_pos) const;
+};
+
+// shortest text that reads back as x, with NaN and missing values as NA and Inf spelled the way R reads them
+std::string format_log_value(double x);
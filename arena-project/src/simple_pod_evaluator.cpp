@@ -1,6 +1,7 @@
 #include "simple_pod_evaluator.hpp"
 
 #include "pod_game.hpp"
+#include "run_log.hpp"
 #include "utility.hpp"
 
 using namespace std;
@@ -9,7 +10,7 @@ using namespace pod_game_parameters;
 simple_pod_evaluator::simple_pod_evaluator() : evaluator() {}
 
 // return basic on-track feature
-double simple_pod_evaluator::evaluate(vec x) {
+scalar simple_pod_evaluator::evaluate(vec x) {
   double thrust = x[1];
   double a_ncp = x[9];
   double c_angle = x[0];
@@ -28,6 +29,80 @@ double simple_pod_evaluator::evaluate(vec x) {
   return angle_match * thrust_match * (boost_match + 0.1);
 }
 
+// same as evaluate, but options of one decision share the state and are
+// ordered by angle, so the target and angle kernel are only recomputed when
+// the state or angle changes between rows
+void simple_pod_evaluator::evaluate_batch(const vector<const vec *> &inputs, scalar *outputs) {
+  double last_ncp = NAN, last_angle = NAN;
+  double target_angle = 0, angle_match = 0;
+
+  for (int i = 0; i < inputs.size(); i++) {
+    const vec &x = *inputs[i];
+    double thrust = x[1];
+    double a_ncp = x[9];
+    double c_angle = x[0];
+    double dist = x[10];
+    bool boost = x[2] > 0;
+
+    if (a_ncp != last_ncp) {
+      target_angle = signum(a_ncp) * fmin(fabs(a_ncp), angular_speed);
+      last_ncp = a_ncp;
+      last_angle = NAN;
+    }
+
+    if (c_angle != last_angle) {
+      angle_match = kernel(angle_difference(c_angle, target_angle), angular_speed / 3);
+      last_angle = c_angle;
+    }
+
+    double target_thrust = 100 * angle_match;
+    double thrust_match = kernel(thrust - target_thrust, 20);
+
+    bool want_boost = dist > 4000 && angle_match > 0.95;
+    double boost_match = boost == want_boost;
+
+    outputs[i] = angle_match * thrust_match * (boost_match + 0.1);
+  }
+}
+
+// the option evaluate scores highest, from the next checkpoint angle and distance and the boost count in the state.
+// For a given turn angle the score only depends on the thrust through the thrust kernel, so only the two thrusts around
+// the target thrust, the boost option and the shield option can be best and the other options are not scored.
+bool simple_pod_evaluator::best_choice(const vec &state, vec &choice) {
+  // input x of evaluate is the choice of dimension 4 followed by the state
+  double a_ncp = state[5];
+  double dist = state[6];
+  bool can_boost = state[13] > 0;
+  double target_angle = signum(a_ncp) * fmin(fabs(a_ncp), angular_speed);
+
+  // candidates come in option order and replace the best one only when strictly better, like choice_selector::best
+  scalar best = -1;
+  auto angle_match = [target_angle](double c_angle) {
+    return kernel(angle_difference(c_angle, target_angle), angular_speed / 3);
+  };
+  auto consider = [&](double c_angle, double angle_match, double thrust, bool boost, bool shield) {
+    double thrust_match = kernel(thrust - 100 * angle_match, 20);
+    bool want_boost = dist > 4000 && angle_match > 0.95;
+    scalar y = angle_match * thrust_match * ((boost == want_boost) + 0.1);
+    if (y > best) {
+      best = y;
+      choice = {(scalar)c_angle, (scalar)thrust, (scalar)boost, (scalar)shield};
+    }
+  };
+
+  for (double a : pod_game::option_angles()) {
+    double c_angle = (scalar)a;
+    double am = angle_match(c_angle);
+    double t = fmin(thrust_step * floor(100 * am / thrust_step), max_thrust);
+    consider(c_angle, am, t, false, false);
+    if (t < max_thrust) consider(c_angle, am, t + thrust_step, false, false);
+    if (can_boost) consider(c_angle, am, max_thrust, true, false);
+  }
+  consider(0, angle_match(0), 0, false, true);
+
+  return true;
+}
+
 evaluator_ptr simple_pod_evaluator::update(vector<record> results, agent_ptr a, double &rel_change) const {
   rel_change = 0;
   return clone();
@@ -41,11 +116,11 @@ evaluator_ptr simple_pod_evaluator::clone() const { return evaluator_ptr(new sim
 std::string simple_pod_evaluator::serialize() const { return "simple_pod_evaluator"; }
 void simple_pod_evaluator::deserialize(std::stringstream &data) {}
 void simple_pod_evaluator::initialize(input_sampler sampler, int cdim, set<int> ireq) {}
-std::string simple_pod_evaluator::status_report() const { return "dummy status"; }
+void simple_pod_evaluator::status_report(log_row &row) const { row.str("dummy status"); }
 double simple_pod_evaluator::complexity() const { return 0; }
 void simple_pod_evaluator::set_weights(const vec &w) {}
 vec simple_pod_evaluator::get_weights() const { return {}; }
-vec simple_pod_evaluator::gradient(vec input, double target) const { return {}; }
+vec simple_pod_evaluator::gradient(vec input, scalar target) const { return {}; }
 set<int> simple_pod_evaluator::list_inputs() const {
   vector<int> buf = seq(0, 100);
   return set<int>(buf.begin(), buf.end());
@@ -6,7 +6,9 @@
 class simple_pod_evaluator : public evaluator {
  public:
   simple_pod_evaluator();
-  double evaluate(vec x) override;
+  scalar evaluate(vec x) override;
+  void evaluate_batch(const std::vector<const vec *> &inputs, scalar *outputs) override;
+  bool best_choice(const vec &state, vec &choice) override;
   evaluator_ptr update(std::vector<record> records, agent_ptr a, double &rel_change) const override;
   void prune(double limit = 0) override;
   evaluator_ptr mate(evaluator_ptr partner) const override;
@@ -15,11 +17,11 @@ class simple_pod_evaluator : public evaluator {
   std::string serialize() const override;
   void deserialize(std::stringstream &ss) override;
   void initialize(input_sampler sampler, int cdim, std::set<int> ireq) override;
-  std::string status_report() const override;
+  void status_report(log_row &row) const override;
   double complexity() const override;
   std::set<int> list_inputs() const override;
   void add_inputs(std::set<int> inputs) override;
   void set_weights(const vec &x) override;
   vec get_weights() const override;
-  vec gradient(vec input, double target) const override;
+  vec gradient(vec input, scalar target) const override;
 };
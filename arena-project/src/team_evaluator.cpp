@@ -3,6 +3,7 @@
 #include <sstream>
 
 #include "evaluator.hpp"
+#include "run_log.hpp"
 #include "tree_evaluator.hpp"
 #include "utility.hpp"
 
@@ -34,11 +35,11 @@ vec team_evaluator::get_weights() const {
 
 // gradient of delta² - w_reg |w|
 // wrt w, where delta = target - output
-vec team_evaluator::gradient(vec input, double target) const {
+vec team_evaluator::gradient(vec input, scalar target) const {
   return {};
 }
 
-double team_evaluator::evaluate(vec x) {
+scalar team_evaluator::evaluate(vec x) {
   int team_idx = x[role_index];
 
   // sanity check
@@ -48,6 +49,45 @@ double team_evaluator::evaluate(vec x) {
   return evals[team_idx]->evaluate(x);
 }
 
+float team_evaluator::evaluate_float(const fvec &x) {
+  int team_idx = x[role_index];
+  assert(team_idx < evals.size() && team_idx >= 0);
+  return evals[team_idx]->evaluate_float(x);
+}
+
+double team_evaluator::evaluate_double(const dvec &x) {
+  int team_idx = x[role_index];
+  assert(team_idx < evals.size() && team_idx >= 0);
+  return evals[team_idx]->evaluate_double(x);
+}
+
+// split rows by role and run one batch per role evaluator
+void team_evaluator::evaluate_batch(const vector<const vec *> &inputs, scalar *outputs) {
+  int n = inputs.size();
+  vector<vector<int>> rows(evals.size());
+
+  for (int i = 0; i < n; i++) {
+    int team_idx = (*inputs[i])[role_index];
+    assert(team_idx < evals.size() && team_idx >= 0);
+    rows[team_idx].push_back(i);
+  }
+
+  for (int k = 0; k < evals.size(); k++) {
+    if (rows[k].empty()) continue;
+
+    if (rows[k].size() == n) {
+      evals[k]->evaluate_batch(inputs, outputs);
+      return;
+    }
+
+    vector<const vec *> sub_inputs(rows[k].size());
+    vec sub_outputs(rows[k].size());
+    for (int i = 0; i < rows[k].size(); i++) sub_inputs[i] = inputs[rows[k][i]];
+    evals[k]->evaluate_batch(sub_inputs, sub_outputs.data());
+    for (int i = 0; i < rows[k].size(); i++) outputs[rows[k][i]] = sub_outputs[i];
+  }
+}
+
 evaluator_ptr team_evaluator::update(std::vector<record> results, agent_ptr a, double &rel_change) const {
   team_evaluator::ptr buf = static_pointer_cast<team_evaluator>(clone());
   if (results.empty()) return buf;
@@ -125,14 +165,9 @@ void team_evaluator::initialize(input_sampler sampler, int cdim, std::set<int> i
   update_stable();
 }
 
-std::string team_evaluator::status_report() const {
-  stringstream ss;
-
-  ss << complexity() << comma
-     << mut_tag << comma
-     << join_string(map<evaluator_ptr, string>([](evaluator_ptr e) { return e->status_report(); }, evals), comma);
-
-  return ss.str();
+void team_evaluator::status_report(log_row &row) const {
+  row.f64(complexity()).i64(mut_tag);
+  for (auto e : evals) e->status_report(row);
 }
 
 evaluator_ptr team_evaluator::clone() const {
@@ -16,7 +16,10 @@ class team_evaluator : public evaluator {
   team_evaluator();
   team_evaluator(std::vector<evaluator_ptr> e, int ri);
 
-  double evaluate(vec x) override;
+  scalar evaluate(vec x) override;
+  float evaluate_float(const fvec &x) override;
+  double evaluate_double(const dvec &x) override;
+  void evaluate_batch(const std::vector<const vec *> &inputs, scalar *outputs) override;
   evaluator_ptr update(std::vector<record> records, agent_ptr a, double &rel_change) const override;
   void reset_memory_weights(double a) override;
   void prune(double limit = 0) override;
@@ -25,14 +28,14 @@ class team_evaluator : public evaluator {
   std::string serialize() const override;
   void deserialize(std::stringstream &ss) override;
   void initialize(input_sampler sampler, int cdim, std::set<int> ireq) override;
-  std::string status_report() const override;
+  void status_report(log_row &row) const override;
   evaluator_ptr clone() const override;
   double complexity() const override;
   std::set<int> list_inputs() const override;
   void add_inputs(std::set<int> inputs) override;
   void set_weights(const vec &x) override;
   vec get_weights() const override;
-  vec gradient(vec input, double delta) const override;
+  vec gradient(vec input, scalar target) const override;
 
   void update_stable();
 };
@@ -0,0 +1,124 @@
+#include "trace.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "utility.hpp"
+
+using namespace std;
+
+namespace trace {
+struct event {
+  const char *name;
+  int agent_id;
+  int game_id;
+  int epoch;
+  long ts;
+  long dur;
+};
+
+struct thread_buffer {
+  int tid;
+  MutexType m;
+  vector<event> events;
+};
+
+bool is_enabled = false;
+bool first_event = true;
+int current_epoch = 0;
+string trace_file;
+chrono::steady_clock::time_point t0;
+
+vector<thread_buffer *> &registry() {
+  static vector<thread_buffer *> buffers;
+  return buffers;
+}
+
+MutexType &registry_lock() {
+  static MutexType m;
+  return m;
+}
+
+thread_buffer *local_buffer() {
+  static thread_local thread_buffer *local = 0;
+
+  if (!local) {
+    local = new thread_buffer;
+    registry_lock().Lock();
+    local->tid = registry().size();
+    registry().push_back(local);
+    registry_lock().Unlock();
+  }
+
+  return local;
+}
+
+long micros_since_start(chrono::steady_clock::time_point t) {
+  return chrono::duration_cast<chrono::microseconds>(t - t0).count();
+}
+
+void start(string filename) {
+#ifndef ENABLE_TRACE
+  cout << "trace: built without ENABLE_TRACE, no spans will be recorded" << endl;
+#endif
+
+  trace_file = filename;
+  t0 = chrono::steady_clock::now();
+  is_enabled = true;
+
+  // json array format, the closing bracket is optional so events can be appended
+  ofstream f(trace_file);
+  f << "[" << endl;
+  f.close();
+}
+
+bool enabled() { return is_enabled; }
+void set_epoch(int epoch) { current_epoch = epoch; }
+
+void flush() {
+  if (!is_enabled) return;
+
+  ofstream f(trace_file, ios::app);
+
+  registry_lock().Lock();
+  for (auto b : registry()) {
+    vector<event> buf;
+    b->m.Lock();
+    buf.swap(b->events);
+    b->m.Unlock();
+
+    for (auto &e : buf) {
+      if (!first_event) f << "," << endl;
+      first_event = false;
+
+      f << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":0"
+        << ",\"tid\":" << b->tid
+        << ",\"ts\":" << e.ts
+        << ",\"dur\":" << e.dur
+        << ",\"args\":{\"agent\":" << e.agent_id
+        << ",\"game\":" << e.game_id
+        << ",\"epoch\":" << e.epoch << "}}";
+    }
+  }
+  registry_lock().Unlock();
+
+  f.close();
+}
+
+span::span(const char *name, int agent_id, int game_id) : name(name), agent_id(agent_id), game_id(game_id) {
+  if (is_enabled) t_start = chrono::steady_clock::now();
+}
+
+span::~span() {
+  if (!is_enabled) return;
+
+  auto t_end = chrono::steady_clock::now();
+  event e = {name, agent_id, game_id, current_epoch, micros_since_start(t_start), micros_since_start(t_end) - micros_since_start(t_start)};
+
+  thread_buffer *b = local_buffer();
+  b->m.Lock();
+  b->events.push_back(e);
+  b->m.Unlock();
+}
+};  // namespace trace
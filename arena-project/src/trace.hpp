@@ -0,0 +1,38 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+// Timeline tracing in chrome trace json (open in perfetto or chrome://tracing).
+// Spans are only recorded when built with ENABLE_TRACE and started with trace::start.
+namespace trace {
+void start(std::string filename);
+bool enabled();
+void set_epoch(int epoch);
+
+// append buffered events of all threads to the trace file
+void flush();
+
+// records a complete event from construction to destruction
+struct span {
+  const char *name;
+  int agent_id;
+  int game_id;
+  std::chrono::steady_clock::time_point t_start;
+
+  span(const char *name, int agent_id = -1, int game_id = -1);
+  ~span();
+};
+};  // namespace trace
+
+#ifdef ENABLE_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(...) trace::span TRACE_CONCAT(trace_span_, __LINE__)(__VA_ARGS__)
+#define TRACE_SPAN_NAMED(var, ...) trace::span var(__VA_ARGS__)
+#define TRACE_SET_AGENT(var, id) var.agent_id = (id)
+#else
+#define TRACE_SPAN(...)
+#define TRACE_SPAN_NAMED(var, ...)
+#define TRACE_SET_AGENT(var, id)
+#endif
@@ -5,6 +5,7 @@
 #include <cmath>
 #include <sstream>
 
+#include "run_log.hpp"
 #include "utility.hpp"
 
 #define VERBOSE false
@@ -29,8 +30,6 @@ enum binary_ops {
   BINARY_NUM
 };
 
-vector<t_unary> unary_op;
-vector<t_binary> binary_op;
 vector<string> unary_op_names = {
     "sin",
     "cos",
@@ -39,71 +38,91 @@ vector<string> unary_op_names = {
     "abs"};
 vector<string> binary_op_names = {"kernel", "product"};
 
-void init_ops() {
-  static bool init = false;
-  if (init) return;
-
-  MutexType m;
-  m.Lock();
-
-  cout << "Running init ops" << endl;
+// Operator kernels, templated on the scalar type so the same tree can be
+// evaluated in single or double precision
+template <typename T>
+T unary_f(int fname, T x) {
+  switch (fname) {
+    case UNARY_SIN:
+      return sin(x);
+    case UNARY_COS:
+      return cos(x);
+    case UNARY_ATAN:
+      return atan(x);
+    case UNARY_SIGMOID:
+      return 1 / (1 + exp(-x));
+    case UNARY_ABS:
+      return fabs(x);
+    default:
+      throw runtime_error("Invalid unary op: " + to_string(fname));
+  }
+}
 
-  unary_op.resize(UNARY_NUM);
+template <typename T>
+T unary_fprime(int fname, T x) {
+  switch (fname) {
+    case UNARY_SIN:
+      return cos(x);
+    case UNARY_COS:
+      return -sin(x);
+    case UNARY_ATAN:
+      return 1 / (1 + x * x);
+    case UNARY_SIGMOID:
+      if (fabs(x) > 20) return 0;
+      return exp(-x) / ((1 + exp(-x)) * (1 + exp(-x)));
+    case UNARY_ABS:
+      return (x > 0) - (x < 0);
+    default:
+      throw runtime_error("Invalid unary op: " + to_string(fname));
+  }
+}
 
-  unary_op[UNARY_SIN].f = [](double x) { return sin(x); };
-  unary_op[UNARY_SIN].fprime = [](double x) { return cos(x); };
-  unary_op[UNARY_COS].f = [](double x) { return cos(x); };
-  unary_op[UNARY_COS].fprime = [](double x) { return -sin(x); };
-  unary_op[UNARY_ATAN].f = [](double x) { return atan(x); };
-  unary_op[UNARY_ATAN].fprime = [](double x) { return 1 / (1 + pow(x, 2)); };
-  unary_op[UNARY_SIGMOID].f = [](double x) { return 1 / (1 + exp(-x)); };
-  unary_op[UNARY_SIGMOID].fprime = [](double x) -> double {
-    if (fabs(x) > 20) {
+template <typename T>
+T binary_f(int fname, T x, T h) {
+  switch (fname) {
+    case BINARY_KERNEL: {
+      T z = x / h;
+      if (h > 0 && z * z < 40) return exp(-z * z);
       return 0;
-    } else {
-      return exp(-x) / pow(1 + exp(-x), 2);
     }
-  };
-  unary_op[UNARY_ABS].f = [](double x) { return fabs(x); };
-  unary_op[UNARY_ABS].fprime = [](double x) { return (x > 0) - (x < 0); };
-
-  binary_op.resize(BINARY_NUM);
+    case BINARY_PRODUCT:
+      return x * h;
+    default:
+      throw runtime_error("Invalid binary op: " + to_string(fname));
+  }
+}
 
-  binary_op[BINARY_KERNEL].f = [](double x, double h) -> double {
-    if (h > 0 && pow(x / h, 2) < 40) {
-      return exp(-pow(x / h, 2));
-    } else {
+template <typename T>
+T binary_dfdx1(int fname, T x, T h) {
+  switch (fname) {
+    case BINARY_KERNEL: {
+      T z = x / h;
+      if (h > 0 && z * z < 40) return -2 * x / (h * h) * exp(-z * z);
       return 0;
     }
-  };
-
-  binary_op[BINARY_KERNEL].dfdx1 = [](double x, double h) -> double {
-    if (h > 0 && pow(x / h, 2) < 40) {
-      return -2 * x / pow(h, 2) * exp(-pow(x / h, 2));
-    } else {
-      return 0;
-    }
-  };
+    case BINARY_PRODUCT:
+      return h;
+    default:
+      throw runtime_error("Invalid binary op: " + to_string(fname));
+  }
+}
 
-  binary_op[BINARY_KERNEL].dfdx2 = [](double x, double h) -> double {
-    if (h > 0 && pow(x / h, 2) < 40) {
-      return 2 * pow(x, 2) / pow(h, 3) * exp(-pow(x / h, 2));
-    } else {
+template <typename T>
+T binary_dfdx2(int fname, T x, T h) {
+  switch (fname) {
+    case BINARY_KERNEL: {
+      T z = x / h;
+      if (h > 0 && z * z < 40) return 2 * x * x / (h * h * h) * exp(-z * z);
       return 0;
     }
-  };
-
-  binary_op[BINARY_PRODUCT].f = [](double a, double b) { return a * b; };
-  binary_op[BINARY_PRODUCT].dfdx1 = [](double a, double b) { return b; };
-  binary_op[BINARY_PRODUCT].dfdx2 = [](double a, double b) { return a; };
-
-  m.Unlock();
-
-  init = true;
+    case BINARY_PRODUCT:
+      return x;
+    default:
+      throw runtime_error("Invalid binary op: " + to_string(fname));
+  }
 }
 
 tree_evaluator::tree_evaluator() : evaluator() {
-  init_ops();
   gamma = fabs(rnorm(0.01, 0.005));
   tag = "tree";
 }
@@ -281,17 +300,17 @@ tree_evaluator::tree::ptr tree_evaluator::tree::clone() {
   return t;
 }
 
-double tree_evaluator::tree::evaluate(const vec &x) {
-  double val;
+scalar tree_evaluator::tree::evaluate(const vec &x) {
+  scalar val;
 
   if (class_id == CONSTANT_TREE) {
     val = const_value;
   } else if (class_id == INPUT_TREE) {
     val = x[input_index];
   } else if (class_id == UNARY_TREE) {
-    val = unary_op[fname].f(subtree[0]->evaluate(x));
+    val = unary_f<scalar>(fname, subtree[0]->evaluate(x));
   } else if (class_id == BINARY_TREE) {
-    val = binary_op[fname].f(subtree[0]->evaluate(x), subtree[1]->evaluate(x));
+    val = binary_f<scalar>(fname, subtree[0]->evaluate(x), subtree[1]->evaluate(x));
   } else if (class_id == WEIGHT_TREE) {
     val = 0;
     for (auto a : subtree) val += a->evaluate(x);
@@ -302,6 +321,63 @@ double tree_evaluator::tree::evaluate(const vec &x) {
   return resbuf = w * val;
 }
 
+// same as evaluate but in a fixed precision and without touching resbuf
+template <typename T>
+T tree_evaluator::tree::evaluate_as(const std::vector<T> &x) const {
+  T val;
+
+  if (class_id == CONSTANT_TREE) {
+    val = const_value;
+  } else if (class_id == INPUT_TREE) {
+    val = x[input_index];
+  } else if (class_id == UNARY_TREE) {
+    val = unary_f<T>(fname, subtree[0]->evaluate_as(x));
+  } else if (class_id == BINARY_TREE) {
+    val = binary_f<T>(fname, subtree[0]->evaluate_as(x), subtree[1]->evaluate_as(x));
+  } else if (class_id == WEIGHT_TREE) {
+    val = 0;
+    for (auto &a : subtree) val += a->evaluate_as(x);
+  } else {
+    throw runtime_error("Invalid tree class id!");
+  }
+
+  return (T)w * val;
+}
+
+// evaluate one subtree level for all rows at a time, does not touch resbuf so
+// several threads can evaluate the same tree
+void tree_evaluator::tree::evaluate_batch(const vector<const vec *> &x, scalar *out, int depth) const {
+  static thread_local vector<vec> scratch;
+  int n = x.size();
+
+  if (scratch.size() <= depth) scratch.resize(depth + 1);
+  if (scratch[depth].size() < 2 * n) scratch[depth].resize(2 * n);
+  scalar *a = scratch[depth].data();
+  scalar *b = a + n;
+
+  if (class_id == CONSTANT_TREE) {
+    for (int i = 0; i < n; i++) out[i] = w * const_value;
+  } else if (class_id == INPUT_TREE) {
+    for (int i = 0; i < n; i++) out[i] = w * (*x[i])[input_index];
+  } else if (class_id == UNARY_TREE) {
+    subtree[0]->evaluate_batch(x, a, depth + 1);
+    for (int i = 0; i < n; i++) out[i] = w * unary_f<scalar>(fname, a[i]);
+  } else if (class_id == BINARY_TREE) {
+    subtree[0]->evaluate_batch(x, a, depth + 1);
+    subtree[1]->evaluate_batch(x, b, depth + 1);
+    for (int i = 0; i < n; i++) out[i] = w * binary_f<scalar>(fname, a[i], b[i]);
+  } else if (class_id == WEIGHT_TREE) {
+    for (int i = 0; i < n; i++) a[i] = 0;
+    for (auto &t : subtree) {
+      t->evaluate_batch(x, b, depth + 1);
+      for (int i = 0; i < n; i++) a[i] += b[i];
+    }
+    for (int i = 0; i < n; i++) out[i] = w * a[i];
+  } else {
+    throw runtime_error("Invalid tree class id!");
+  }
+}
+
 void tree_evaluator::tree::initialize(vector<int> inputs) {
   subtree.clear();
   w = rnorm();
@@ -377,7 +453,7 @@ void tree_evaluator::tree::emplace_subtree(tree::ptr x, double p_put) {
 }
 
 // must run evaluate first to set resbuf
-int tree_evaluator::tree::calculate_dw(vec &dydw, int offset, double alpha) {
+int tree_evaluator::tree::calculate_dw(vec &dydw, int offset, scalar alpha) {
   if (w == 0) {
     dydw[offset] = 0;  // once a weight hits zero, leave it there for later pruning
   } else {
@@ -387,15 +463,15 @@ int tree_evaluator::tree::calculate_dw(vec &dydw, int offset, double alpha) {
   offset++;
 
   if (class_id == BINARY_TREE) {
-    double y1 = subtree[0]->resbuf;
-    double y2 = subtree[1]->resbuf;
-    double left_deriv = binary_op[fname].dfdx1(y1, y2);
-    double right_deriv = binary_op[fname].dfdx2(y1, y2);
+    scalar y1 = subtree[0]->resbuf;
+    scalar y2 = subtree[1]->resbuf;
+    scalar left_deriv = binary_dfdx1<scalar>(fname, y1, y2);
+    scalar right_deriv = binary_dfdx2<scalar>(fname, y1, y2);
     offset = subtree[0]->calculate_dw(dydw, offset, w * left_deriv * alpha);
     offset = subtree[1]->calculate_dw(dydw, offset, w * right_deriv * alpha);
   } else if (class_id == UNARY_TREE) {
-    double y = subtree[0]->resbuf;
-    double deriv = unary_op[fname].fprime(y);
+    scalar y = subtree[0]->resbuf;
+    scalar deriv = unary_fprime<scalar>(fname, y);
     offset = subtree[0]->calculate_dw(dydw, offset, w * deriv * alpha);
   } else if (class_id == WEIGHT_TREE) {
     for (auto a : subtree) {
@@ -495,9 +571,9 @@ vec tree_evaluator::tree::get_weights() const {
   return res;
 }
 
-vec tree_evaluator::gradient(vec input, double target) const {
-  double output = root->evaluate(input);
-  double delta = target - output;
+vec tree_evaluator::gradient(vec input, scalar target) const {
+  scalar output = root->evaluate(input);
+  scalar delta = target - output;
   vec dydw = root->get_weights();
   int offset = root->calculate_dw(dydw, 0, 1);
 
@@ -516,10 +592,23 @@ evaluator_ptr tree_evaluator::clone() const {
   return e;
 }
 
-double tree_evaluator::evaluate(vec x) {
+scalar tree_evaluator::evaluate(vec x) {
   return root->evaluate(x);
 }
 
+float tree_evaluator::evaluate_float(const fvec &x) {
+  return root->evaluate_as(x);
+}
+
+double tree_evaluator::evaluate_double(const dvec &x) {
+  return root->evaluate_as(x);
+}
+
+void tree_evaluator::evaluate_batch(const vector<const vec *> &inputs, scalar *outputs) {
+  if (inputs.empty()) return;
+  root->evaluate_batch(inputs, outputs);
+}
+
 void tree_evaluator::prune(double l) {
   root->prune(l);
 }
@@ -571,7 +660,7 @@ vec tree_evaluator::get_weights() const {
   return root->get_weights();
 }
 
-void tree_evaluator::initialize(input_sampler sampler, int cdim, set<int> ireq) {
+void tree_evaluator::initialize(input_sampler, int cdim, set<int> ireq) {
   stable = true;
   dim = cdim;
   weight_limit = u01(100, 10000);
@@ -589,8 +678,8 @@ void tree_evaluator::initialize(input_sampler sampler, int cdim, set<int> ireq)
   root->initialize(ibuf);
 }
 
-string tree_evaluator::status_report() const {
-  return to_string(gamma) + comma + to_string(l2norm(get_weights())) + comma + to_string(complexity());
+void tree_evaluator::status_report(log_row &row) const {
+  row.f64(gamma).f64(l2norm(get_weights())).f64(complexity());
 }
 
 set<int> tree_evaluator::list_inputs() const {
@@ -15,21 +15,24 @@ class tree_evaluator : public evaluator {
 
   struct tree : public std::enable_shared_from_this<tree> {
     typedef std::shared_ptr<tree> ptr;
-    double w;
+    scalar w;
     tree_class class_id;
-    double const_value;
+    scalar const_value;
     int input_index;
     int fname;
     std::vector<ptr> subtree;
-    double resbuf;
+    scalar resbuf;
 
-    double evaluate(const vec &x);
+    scalar evaluate(const vec &x);
+    template <typename T>
+    T evaluate_as(const std::vector<T> &x) const;
+    void evaluate_batch(const std::vector<const vec *> &x, scalar *out, int depth = 0) const;
     void initialize(std::vector<int> inputs);
     void example_setup(int cdim);
     ptr get_subtree(double p_cut);
     void emplace_subtree(ptr, double p_put);
     ptr clone();
-    int calculate_dw(vec &dgdw, int offset, double alpha);
+    int calculate_dw(vec &dgdw, int offset, scalar alpha);
     int set_weights(const vec &x, int offset = 0);
     vec get_weights() const;
     int count_trees();
@@ -52,21 +55,24 @@ class tree_evaluator : public evaluator {
   double weight_limit;
 
   tree_evaluator();
-  double evaluate(vec x) override;  // modifies resbuf
+  scalar evaluate(vec x) override;  // modifies resbuf
+  float evaluate_float(const fvec &x) override;
+  double evaluate_double(const dvec &x) override;
+  void evaluate_batch(const std::vector<const vec *> &inputs, scalar *outputs) override;
   void prune(double limit = 0) override;
   evaluator_ptr mate(evaluator_ptr partner) const override;
   evaluator_ptr mutate(dist_category dc) const override;
   std::string serialize() const override;
   void deserialize(std::stringstream &ss) override;
   void initialize(input_sampler sampler, int cdim, std::set<int> ireq) override;
-  std::string status_report() const override;
+  void status_report(log_row &row) const override;
   evaluator_ptr clone() const override;
   double complexity() const override;
   std::set<int> list_inputs() const override;
   void add_inputs(std::set<int> inputs) override;
   void set_weights(const vec &x) override;
   vec get_weights() const override;
-  vec gradient(vec input, double delta) const override;
+  vec gradient(vec input, scalar target) const override;
 
   void example_setup(int cdim);
 };
@@ -15,6 +15,7 @@ class choice_selector;
 class choice;
 class population_manager;
 class tournament;
+class log_row;
 
 typedef std::shared_ptr<agent> agent_ptr;
 typedef std::shared_ptr<game> game_ptr;
@@ -25,7 +26,17 @@ typedef std::shared_ptr<evaluator> evaluator_ptr;
 typedef std::shared_ptr<population_manager> population_manager_ptr;
 typedef std::shared_ptr<tournament> tournament_ptr;
 
-typedef std::vector<double> vec;
+// Scalar type for evaluator inputs, outputs, weights and gradients. Build
+// with -DSINGLE_PRECISION to run evaluation and training in float.
+#ifdef SINGLE_PRECISION
+typedef float scalar;
+#else
+typedef double scalar;
+#endif
+
+typedef std::vector<scalar> vec;
+typedef std::vector<float> fvec;
+typedef std::vector<double> dvec;
 
 struct point {
   double x;
@@ -38,7 +49,7 @@ using hm = std::unordered_map<K, V>;
 struct option {
   vec choice;
   vec input;
-  double output;
+  scalar output;
   int original_idx;
 };
 struct record {
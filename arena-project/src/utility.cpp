@@ -4,10 +4,12 @@
 #include <cassert>
 #include <cfloat>
 #include <cmath>
+#include <cstdlib>
 #include <iterator>
 #include <random>
 #include <sstream>
 
+#include "profiling.hpp"
 #include "types.hpp"
 
 using namespace std;
@@ -54,7 +56,7 @@ optim_result<double> voptim(vec x, function<double(vec)> fopt, function<vec(vec)
   vec x_best = x;
   double y_best = y;
 
-  vec ys = {y};
+  vec ys = {(scalar)y};
   for (i = 0; i < max_its && l2norm(d) > xlim && l2norm(x) < border && fabs(y_last - y) / y > rel_lim; i++) {
     d = fgrad(x);
 
@@ -77,7 +79,7 @@ optim_result<double> voptim(vec x, function<double(vec)> fopt, function<vec(vec)
       return d;
     };
 
-    d = map<double, double>(f0c, d);
+    d = map<scalar, scalar>(f0c, d);
 
     // ds.push_back(d);
 
@@ -89,6 +91,7 @@ optim_result<double> voptim(vec x, function<double(vec)> fopt, function<vec(vec)
 
     x_last = x;
     x = x - d;
+    profiling::count(profiling::PC_OPTIM_STEPS);
 
     y_last = y;
     y = fopt(x);
@@ -219,7 +222,7 @@ double mem_weight(double ss, double cs) {
   double term2 = 1e-1 * psigmoid(ss - 1, 0.3);  // from 0
   double term3 = cs;
 
-  return fmax(sum({term1, term2, term3}), 1e-3);
+  return fmax(sum({(scalar)term1, (scalar)term2, (scalar)term3}), 1e-3);
 }
 
 mt19937 &get_random_engine() {
@@ -229,6 +232,12 @@ mt19937 &get_random_engine() {
   return gen;
 }
 
+// fix the random sequence, also seeds rand() which is used by random_shuffle
+void seed_random_engine(unsigned int seed) {
+  get_random_engine().seed(seed);
+  srand(seed);
+}
+
 double u01(double a, double b) {
   uniform_real_distribution<double> distribution(a, b);
   mt19937 &gen = get_random_engine();
@@ -356,7 +365,7 @@ int max_idx(vec x) {
 
 double stdev(vec x) {
   double m = mean(x);
-  function<double(double)> f = [m](double x) -> double { return pow(x - m, 2); };
+  function<scalar(scalar)> f = [m](scalar x) -> scalar { return pow(x - m, 2); };
   return sqrt(sum(map(f, x)));
 }
 
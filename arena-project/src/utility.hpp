@@ -121,6 +121,7 @@ double u01(double a = 0, double b = 1);
 double rnorm(double m = 0, double s = 1);
 
 int rand_int(int a, int b);
+void seed_random_engine(unsigned int seed);
 
 double signum(double x);
 
@@ -0,0 +1,248 @@
+#include <vector>
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <functional>
+#include <cstring>
+
+#include "brain.hpp"
+#include "brain_batch.hpp"
+#include "event_brain.hpp"
+#include "util.hpp"
+
+using namespace std;
+
+// Usage: SRBBench [seed n] [time seconds] [out file] [nofeedback] [sparse n]
+// Brains are generated from the seed and results are written as json.
+// The sparse benchmarks compare Brain::update and EventBrain on one brain of sparse n nodes, default 20000, with the
+// uptake scaled down to get lower firing rates. Their firing_rate is the fraction of nodes firing per tick.
+
+struct BenchResult
+{
+    string name;
+    int n;
+    long iterations;
+    double ns_per_op;
+    double firing_rate = -1;
+};
+
+// Run f repeatedly for at least min_time seconds, with debug output silenced
+BenchResult run_bench(string name, int n, double min_time, function<void()> f)
+{
+    ofstream null_stream;
+    streambuf *cout_buf = cout.rdbuf(null_stream.rdbuf());
+
+    f();
+
+    long its = 0;
+    double elapsed = 0;
+    auto t0 = chrono::steady_clock::now();
+    while (elapsed < min_time)
+    {
+        f();
+        its++;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    }
+
+    cout.rdbuf(cout_buf);
+    cerr << name << ": " << 1e9 * elapsed / its << " ns/op" << endl;
+
+    return {name, n, its, 1e9 * elapsed / its};
+}
+
+vector<bool> random_input(int d_in)
+{
+    vector<bool> x(d_in);
+    for (int i = 0; i < d_in; i++)
+    {
+        x[i] = random_float(0, 1) < 0.2;
+    }
+    return x;
+}
+
+string to_json(const vector<BenchResult> &res, unsigned int seed, double min_time)
+{
+    stringstream ss;
+    ss << "{" << endl
+       << "  \"seed\": " << seed << "," << endl
+       << "  \"min_time\": " << min_time << "," << endl
+       << "  \"benchmarks\": [" << endl;
+
+    for (int i = 0; i < res.size(); i++)
+    {
+        ss << "    {\"name\": \"" << res[i].name << "\", "
+           << "\"param\": " << res[i].n << ", "
+           << "\"iterations\": " << res[i].iterations << ", "
+           << "\"ns_per_op\": " << res[i].ns_per_op;
+        if (res[i].firing_rate >= 0)
+        {
+            ss << ", \"firing_rate\": " << res[i].firing_rate;
+        }
+        ss << "}"
+           << (i < res.size() - 1 ? "," : "") << endl;
+    }
+
+    ss << "  ]" << endl
+       << "}" << endl;
+    return ss.str();
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int seed = 1;
+    double min_time = 0.5;
+    string outfile;
+    bool with_feedback = true;
+    int sparse_n = 20000;
+    const int d_in = 55, d_out = 2, con_depth = 4, track_length = 40;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "seed"))
+        {
+            seed = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "time"))
+        {
+            min_time = atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "out"))
+        {
+            outfile = argv[++i];
+        }
+        else if (!strcmp(argv[i], "nofeedback"))
+        {
+            with_feedback = false;
+        }
+        else if (!strcmp(argv[i], "sparse"))
+        {
+            sparse_n = atoi(argv[++i]);
+        }
+    }
+
+    seed_engine(seed);
+    vector<BenchResult> res;
+
+    for (int n : {60, 250, 1000})
+    {
+        ofstream null_stream;
+        streambuf *cout_buf = cout.rdbuf(null_stream.rdbuf());
+        Brain b(n, 3, d_in, d_out, track_length);
+        b.initialize(con_depth);
+        cout.rdbuf(cout_buf);
+
+        vector<vector<bool>> inputs;
+        for (int i = 0; i < 64; i++)
+        {
+            inputs.push_back(random_input(d_in));
+        }
+
+        int idx = 0;
+        res.push_back(run_bench("brain_update/" + to_string(n), n, min_time, [&]()
+                                {
+            b.set_input(inputs[idx++ % inputs.size()]);
+            b.update(); }));
+
+        // One op steps 8 brains in lockstep, compare with 8 brain_update ops
+        cout.rdbuf(null_stream.rdbuf());
+        vector<Brain> batch_brains;
+        for (int k = 0; k < 8; k++)
+        {
+            batch_brains.emplace_back(n, 3, d_in, d_out, track_length);
+            batch_brains.back().initialize(con_depth);
+        }
+        cout.rdbuf(cout_buf);
+
+        vector<Brain *> batch_ptrs;
+        for (auto &x : batch_brains)
+        {
+            batch_ptrs.push_back(&x);
+        }
+        BrainBatch batch(batch_ptrs);
+        res.push_back(run_bench("batch_update_8/" + to_string(n), n, min_time, [&]()
+                                {
+            for (int k = 0; k < batch.lanes; k++)
+            {
+                batch.set_input(k, inputs[(idx + k) % inputs.size()]);
+            }
+            idx++;
+            batch.update(); }));
+
+        if (with_feedback)
+        {
+            res.push_back(run_bench("brain_feedback/" + to_string(n), n, min_time, [&]()
+                                    {
+                for (int i = 0; i < 10; i++)
+                {
+                    b.set_input(inputs[idx++ % inputs.size()]);
+                    b.update();
+                }
+                b.feedback(idx % 2 ? 1 : -1); }));
+        }
+    }
+
+    // Dense and event driven update against firing rate, new input every 10 ticks as in the tunnel test
+    {
+        ofstream null_stream;
+        streambuf *cout_buf = cout.rdbuf(null_stream.rdbuf());
+        Brain b(sparse_n, 3, d_in, d_out, track_length);
+        b.initialize(con_depth);
+        const string snap = b.snapshot();
+        cout.rdbuf(cout_buf);
+
+        vector<vector<bool>> inputs;
+        for (int i = 0; i < 64; i++)
+        {
+            inputs.push_back(random_input(d_in));
+        }
+
+        for (float scale : {1.0f, 0.1f, 0.02f, 0.005f})
+        {
+            for (bool event : {false, true})
+            {
+                Brain x(snap.data(), snap.size());
+                for (auto &node : x.nodes)
+                {
+                    node.energy_uptake *= scale;
+                }
+                x.layout_dirty = true;
+                EventBrain e(&x);
+
+                int idx = 0;
+                const string name = string(event ? "event_update" : "dense_update") + "/uptake*" + to_string(scale).substr(0, 5);
+                BenchResult r = run_bench(name, sparse_n, min_time, [&]()
+                                          {
+                    if (idx++ % 10 == 0)
+                    {
+                        event ? e.set_input(inputs[idx % inputs.size()]) : x.set_input(inputs[idx % inputs.size()]);
+                    }
+                    event ? e.update() : x.update(); });
+
+                // Firing rate over the spike window the run ends with
+                long spikes = 0;
+                for (node_index i = 0; i < sparse_n; i++)
+                {
+                    spikes += x.spikes.count(i);
+                }
+                r.firing_rate = spikes / (double)sparse_n / (track_length + 1);
+                res.push_back(r);
+            }
+        }
+    }
+
+    string json = to_json(res, seed, min_time);
+    if (outfile.length())
+    {
+        ofstream f(outfile);
+        f << json;
+        f.close();
+    }
+    else
+    {
+        cout << json;
+    }
+
+    return 0;
+}
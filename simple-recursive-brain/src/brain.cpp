@@ -4,6 +4,7 @@
 #include <cmath>
 #include <algorithm>
 
+#include "snapshot.hpp"
 #include "util.hpp"
 #include <iostream>
 
@@ -12,57 +13,9 @@ using namespace std;
 // Return nodes in range 1 that are not connected to range 2, plus nodes in range 2 that are not reachable from range 1
 set<node_index> Brain::find_disconnected_nodes(pair<node_index, node_index> range1, pair<node_index, node_index> range2, int max_depth) const
 {
-    // Implementation of flood fill
-    set<node_index> flooded, horizon, not_connected;
-    for (node_index i = range1.first; i <= range1.second; i++)
-    {
-        // Start with node i as the horizon
-        bool is_connected = false;
-        horizon.insert(i);
-        flooded.clear();
-        int depth = 0;
-        while (horizon.size() && (max_depth == 0 || depth++ < max_depth))
-        {
-            set<node_index> horizon_buf;
-            for (auto j : horizon)
-            {
-                if (j >= range2.first && j <= range2.second)
-                {
-                    // This node (i) is connected to range2!
-                    is_connected = true;
-                }
-                flooded.insert(j);
-
-                for (auto x : edges[j])
-                {
-                    horizon_buf.insert(x.first);
-                }
-
-                // Calculate the set difference manually because the "set_difference" function doesn't work for sets lol
-                for (auto k : flooded)
-                {
-                    horizon_buf.erase(k);
-                }
-            }
-            swap(horizon, horizon_buf);
-        }
-
-        if (!is_connected)
-        {
-            not_connected.insert(i); // Node i in range1 is not connected to range2
-        }
-    }
-
-    // Verify that all of range2 was flooded
-    for (node_index i = range2.first; i <= range2.second; i++)
-    {
-        if (!flooded.contains(i))
-        {
-            not_connected.insert(i);
-        }
-    }
-
-    return not_connected;
+    Reachability r(n, range1, max_depth);
+    r.build(edges);
+    return r.disconnected(range2, max_depth);
 }
 
 // Return true if the brain has no "disconnected" nodes
@@ -88,6 +41,8 @@ void Brain::normalize_edges()
             edges[i][x.first].width = x.second.width / wsum;
         }
     }
+
+    layout_dirty = true;
 }
 
 // Select a random target for a new edge that is not self and also not an input node
@@ -118,6 +73,8 @@ void Brain::add_edge(node_index i, node_index j)
     edges[i][j].width = random_float(0, 1);
     edges[i][j].is_inhibitor = random_float(0, 1) < 0.1;
     nodes[j].parents.push_back(i);
+    reach.add_edge(edges, i, j);
+    layout_dirty = true;
 }
 
 /* This function performs a random walk process.
@@ -169,14 +126,28 @@ bool Brain::is_output_node(node_index idx) const
 // Create initial edges, between one and connectivity edges per node, where whidth sums to 1.
 // Guarantee all nodes are reachable from input in the end
 // Guarantee output is reachable from input in connection_depth steps
+// Reachability from the inputs is updated with every added edge, so each repair is checked against the graph as it
+// is at that point and the graph is always valid when this returns
 void Brain::create_edges(int connectivity, int connection_depth)
 {
-    // In case of re-run, clear the parent index
+    // In case of re-run, clear the parent index and the old edges
     for (auto &n : nodes)
     {
         n.parents.clear();
     }
 
+    for (node_index i = 0; i < n; i++)
+    {
+        if (!is_output_node(i))
+        {
+            edges[i].clear();
+        }
+    }
+
+    const pair<node_index, node_index> input_range = {0, d_in - 1};
+    const pair<node_index, node_index> output_range = {d_in, d_in + d_out - 1};
+    reach = Reachability(n, input_range, connection_depth);
+
     for (node_index i = 0; i < n; i++)
     {
         // Do not create outgoing edges for output nodes
@@ -186,36 +157,35 @@ void Brain::create_edges(int connectivity, int connection_depth)
         }
 
         const int n_connect = random_int(1, connectivity);
-        edges[i].clear();
         for (node_index j = 0; j < n_connect; j++)
         {
             add_edge(i, random_edge_target(i));
         }
     }
 
-    // Connect all non-connected nodes to a random connected node
-    set<node_index> not_connected = find_disconnected_nodes(make_pair(0, d_in - 1), make_pair(d_in, n - 1));
-
     // Sanity check - should not be possible!
-    if (not_connected.size() >= n - d_in)
+    if (reach.disconnected(make_pair(d_in, n - 1)).size() >= n - d_in)
     {
         throw runtime_error("Create edges: all nodes were disconnected!");
     }
 
-    for (auto i : not_connected)
+    // Each input node should have at least one edge to a non-input node
+    for (node_index i = 0; i < d_in; i++)
     {
-        // Each input node should have at least one edge to a non-input node
-        if (is_input_node(i))
+        if (edges[i].empty())
         {
-
-            cout << "An input node " << i << " did not have an edge to a non-input node (total " << edges[i].size() << " edges)!" << endl;
-            for (auto x : edges[i])
-            {
-                cout << x.first << ",";
-            }
-            cout << endl;
+            cout << "An input node " << i << " did not have an edge to a non-input node!" << endl;
             throw runtime_error("No edge from input node!");
         }
+    }
+
+    // Connect all non-connected nodes to a random connected node, connecting a node also connects its descendants
+    for (node_index i = d_in; i < n; i++)
+    {
+        if (reach.reached(i))
+        {
+            continue;
+        }
 
         // Here we must have a non input node that was not reachable from an input node
         // Select a parent that is connected, that is not self, not an output node and not a child node
@@ -223,116 +193,168 @@ void Brain::create_edges(int connectivity, int connection_depth)
         do
         {
             new_parent = random_int(0, n - 1);
-        } while (not_connected.contains(new_parent) || is_output_node(new_parent) || new_parent == i || edges[i].contains(new_parent));
+        } while (!(is_input_node(new_parent) || reach.reached(new_parent)) || is_output_node(new_parent) || new_parent == i || edges[i].contains(new_parent));
 
         // Since new_parent was connected to the input, it can not already be our parent when we our selves are not connected
         add_edge(new_parent, i);
     }
 
     // Fix input nodes not connected to output nodes
-    not_connected = find_disconnected_nodes(make_pair(0, d_in - 1), make_pair(d_in, d_in + d_out - 1), connection_depth);
-    for (auto i : not_connected)
+    for (node_index i = 0; i < d_in; i++)
     {
-        if (i < d_in)
+        if (reach.reaches_any(i, output_range, connection_depth))
         {
-            // Input node that could not reach output
-
-            // Random walk backwards from a random output - there likely exists at least one output node that has a backwards path that does not end prematurely at an input
-            // A case which fails could be when all input nodes are connected to one output node and one input node connects to all output nodes
-            node_index target = random_walk(make_pair(d_in, d_in + d_out - 1), connection_depth - 1, [this](node_index j)
-                                            {
-                    vector<node_index> options = nodes[j].parents;
-                    erase_if(options, [this](node_index k)
-                        { return is_input_node(k); });
-                    return options; });
-
-            // Connect to this node which has a known path to the output
-            add_edge(i, target);
+            continue;
         }
-        else
+
+        // Random walk backwards from a random output - there likely exists at least one output node that has a backwards path that does not end prematurely at an input
+        // A case which fails could be when all input nodes are connected to one output node and one input node connects to all output nodes
+        node_index target = random_walk(output_range, connection_depth - 1, [this](node_index j)
+                                        {
+                vector<node_index> options = nodes[j].parents;
+                erase_if(options, [this](node_index k)
+                    { return is_input_node(k); });
+                return options; });
+
+        // Connect to this node which has a known path to the output
+        add_edge(i, target);
+    }
+
+    // Fix output nodes not reached by input
+    for (node_index i = d_in; i < d_in + d_out; i++)
+    {
+        if (reach.reached(i, connection_depth))
         {
-            // Output node that was not reached by input
-            // Random walk forwards from a random input without hitting an output
-            node_index target = random_walk(make_pair(0, d_in - 1), connection_depth - 1, [this](node_index j)
-                                            {
-                    vector<node_index> options;
-                    for (auto x : edges[j]) {
-                        if (!is_output_node(x.first)) {
-                            options.push_back(x.first);
-                        }
+            continue;
+        }
+
+        // Random walk forwards from a random input without hitting an output
+        node_index target = random_walk(input_range, connection_depth - 1, [this](node_index j)
+                                        {
+                vector<node_index> options;
+                for (auto x : edges[j]) {
+                    if (!is_output_node(x.first)) {
+                        options.push_back(x.first);
                     }
-                    return options; });
+                }
+                return options; });
 
-            // Connect to this node which has a known path from the input
-            add_edge(target, i);
-        }
+        // Connect to this node which has a known path from the input
+        add_edge(target, i);
     }
 
     normalize_edges();
 }
 
+// Build the CSR incoming edge layout and cache per node parameters used by update and feedback
+void Brain::rebuild_layout()
+{
+    in_offset.assign(n + 1, 0);
+    out_offset.assign(n + 1, 0);
+    for (node_index i = 0; i < n; i++)
+    {
+        for (auto x : edges[i])
+        {
+            in_offset[x.first + 1]++;
+        }
+        out_offset[i + 1] = out_offset[i] + edges[i].size();
+    }
+
+    for (node_index j = 0; j < n; j++)
+    {
+        in_offset[j + 1] += in_offset[j];
+    }
+
+    // Walking sources in increasing order keeps each target's incoming edges sorted by source
+    vector<int> cursor(in_offset.begin(), in_offset.end() - 1);
+    in_source.resize(in_offset[n]);
+    in_excite.resize(in_offset[n]);
+    in_inhibit.resize(in_offset[n]);
+    in_edge.resize(in_offset[n]);
+    out_slot.resize(in_offset[n]);
+    for (node_index i = 0; i < n; i++)
+    {
+        int out_k = out_offset[i];
+        for (auto &x : edges[i])
+        {
+            const int k = cursor[x.first]++;
+            in_source[k] = i;
+            in_excite[k] = x.second.is_inhibitor ? 0 : x.second.width;
+            in_inhibit[k] = x.second.is_inhibitor ? x.second.width : 0;
+            in_edge[k] = &x.second;
+            out_slot[out_k++] = k;
+        }
+    }
+
+    node_uptake.resize(n);
+    node_firepower.resize(n);
+    for (node_index i = 0; i < n; i++)
+    {
+        node_uptake[i] = nodes[i].energy_uptake;
+        node_firepower[i] = nodes[i].firepower;
+    }
+
+    transmitted.resize(n);
+    layout_dirty = false;
+}
+
 // Run one increment of the simulation
 // Or modify the firing so we don't loose energy
 void Brain::update()
 {
-    // Update the state in node_buf based on the state in nodes, then swap them to get the new state in nodes
-    vector<Node> node_buf = nodes;
-    vector<float> energy_transmitted(n, 0);
-    vector<float> inhibition_transmitted(n, 0);
+    if (layout_dirty)
+    {
+        rebuild_layout();
+    }
 
-    // Increment time here, so the fired_at timestamps match the output state after the update
+    // Increment time here, so the firing times match the output state after the update
     t++;
+    spikes.advance(t);
 
-    // Identify fired nodes, gather transmitted energy and reset energy on fired nodes
+    // Identify fired nodes, reset energy on fired nodes and inhibition on inhibited nodes
     for (node_index i = 0; i < n; i++)
     {
-        bool was_inhibited = nodes[i].inhibition >= 1;
-        if (was_inhibited)
-        {
-            // Inhibition should activate and reset regardless of whether the node fires
-            node_buf[i].inhibition = 0;
-        }
+        // Inhibition should activate and reset regardless of whether the node fires
+        const bool was_inhibited = inhibition[i] >= 1;
+        const bool fired = energy[i] >= 1 && !was_inhibited;
 
-        if (nodes[i].energy >= 1 && !was_inhibited)
+        transmitted[i] = fired ? node_firepower[i] : 0;
+        energy_buf[i] = fired ? 0 : energy[i];
+        inhibition_buf[i] = was_inhibited ? 0 : inhibition[i];
+
+        if (fired)
         {
-            // This node fired. Transmit energy through edges and set energy to zero.
-            for (auto x : edges[i])
-            {
-                if (x.second.is_inhibitor)
-                {
-                    inhibition_transmitted[x.first] += nodes[i].firepower * x.second.width;
-                }
-                else
-                {
-                    energy_transmitted[x.first] += nodes[i].firepower * x.second.width;
-                }
-            }
-            node_buf[i].energy = 0;
-            node_buf[i].fired_at.push_back(t);
+            spikes.set_fired(i);
         }
     }
 
-    // Add transmitted energy and energy uptake to target nodes and clear old fired_at times
-    for (node_index i = 0; i < n; i++)
+    // Gather transmitted energy through incoming edges and add energy uptake
+    for (node_index j = 0; j < n; j++)
     {
-        node_buf[i].energy += energy_transmitted[i] + nodes[i].energy_uptake;
-        node_buf[i].inhibition += inhibition_transmitted[i];
-        erase_if(node_buf[i].fired_at, [this](time_point time)
-                 { return time < t - track_length; });
+        float energy_in = 0, inhibition_in = 0;
+        for (int k = in_offset[j]; k < in_offset[j + 1]; k++)
+        {
+            const float x = transmitted[in_source[k]];
+            energy_in += x * in_excite[k];
+            inhibition_in += x * in_inhibit[k];
+        }
+
+        energy_buf[j] += energy_in + node_uptake[j];
+        inhibition_buf[j] += inhibition_in;
     }
 
     // Update state
-    nodes.swap(node_buf);
+    energy.swap(energy_buf);
+    inhibition.swap(inhibition_buf);
 }
 
-typedef map<node_index, map<time_point, float>> FeedbackMap;
-
 // Apply the feedback without normalizing the edges (for internal use)
+// Feedback only flows to earlier time points, so the tracked window is swept from t backwards one time slice at a
+// time. A node collects the feedback sent to it through its outgoing edges and only writes to its own incoming
+// edges, so the nodes within a slice are independent of each other.
 void Brain::feedback_frontier(float r)
 {
     // We want to reward the specific temporal pattern, ie that the output nodes fired at the times they did, in relation to the input pattern
-    FeedbackMap frontier;
-    time_point offset_time = t;
     const float not_fired_contribution_factor = 0.25;
     const float edge_adjustment_factor = 0.001;
     const float sadness_increment = 0.001;
@@ -343,98 +365,102 @@ void Brain::feedback_frontier(float r)
         return;
     }
 
-    // Add output nodes to frontier
-    for (node_index i = d_in; i < d_in + d_out; i++)
+    if (layout_dirty)
     {
-        frontier[i][offset_time] = r;
+        rebuild_layout();
     }
 
-    while (!frontier.empty())
+    // Column c of the feedback matrix holds time point t - c
+    const int w = track_length + 1;
+    discount.resize(w);
+    for (int c = 0; c < w; c++)
     {
-        FeedbackMap frontier_buf;
-        for (auto x : frontier)
+        discount[c] = pow(temporal_discount_factor, c);
+    }
+    edge_feedback.assign(in_source.size() * w, 0);
+
+    for (int c = 0; c < w; c++)
+    {
+        const time_point t2 = t - c;
+
+#pragma omp parallel for schedule(static) if (n >= 1000)
+        for (node_index i = 0; i < n; i++)
         {
-            const node_index i = x.first;
-            for (auto y : x.second)
+            // Output nodes are rewarded directly at every time point, discounted by age
+            float r2 = is_output_node(i) ? discount[c] * r : 0;
+            for (int k = out_offset[i]; k < out_offset[i + 1]; k++)
+            {
+                r2 += edge_feedback[(size_t)out_slot[k] * w + c];
+            }
+
+            if (r2 == 0)
+            {
+                continue;
+            }
+
+            const time_point t1 = spikes.last_fired_before(i, t2);
+            const bool did_fire = spikes.did_fire_at(i, t2);
+            bool any_active_parents = false;
+
+            for (int k = in_offset[i]; k < in_offset[i + 1]; k++)
             {
-                const float r2 = y.second;
-                const time_point t2 = y.first;
-                const time_point t1 = nodes[i].last_fired_before(t2); // Will be -1 if the node did not fire befor t2
-                const bool did_fire = nodes[i].did_fire_at(t2);
-                bool any_active_parents = false;
+                Edge &edge = *in_edge[k];
+                float *sent = edge_feedback.data() + (size_t)k * w;
+                bool parent_did_fire = false;
 
-                for (node_index parent_idx : nodes[i].parents)
+                // Only parent firings since the node last fired count, t1 is -1 if the node did not fire in the window
+                spikes.for_each_fired(in_source[k], t1, t2 - 1, [&](time_point parent_fired_time)
                 {
-                    bool parent_did_fire = false;
-                    for (time_point parent_fired_time : nodes[parent_idx].fired_at)
+                    const int pc = t - parent_fired_time;
+                    const float gamma = discount[pc];
+
+                    // Set a limit when the feedback gets too small
+                    if (fabs(gamma * r2) < 1e-6)
                     {
-                        const float gamma = pow(temporal_discount_factor, t - parent_fired_time);
+                        return;
+                    }
 
-                        // Set a limit when the feedback gets too small
-                        if (fabs(gamma * r2) < 1e-6 || parent_fired_time < t1 || parent_fired_time >= t2)
-                        {
-                            continue;
-                        }
+                    parent_did_fire = true;
+                    any_active_parents = true;
 
-                        parent_did_fire = true;
-                        any_active_parents = true;
+                    // Determine whether we like that the parent fired at us
+                    // Used energy (Y/N) * Got energy (Y/N) * Happy with result (Y/N)
+                    const int used_type_sign = (2 * did_fire - 1);
+                    const int parent_contributed = used_type_sign * edge.get_type_sign();
+                    const float modified_feedback = gamma * parent_contributed * r2;
 
-                        // Determine whether we like that the parent fired at us
-                        // Used energy (Y/N) * Got energy (Y/N) * Happy with result (Y/N)
-                        const int used_type_sign = (2 * did_fire - 1);
-                        const int parent_contributed = used_type_sign * edges[parent_idx][i].get_type_sign();
-                        const float modified_feedback = gamma * parent_contributed * r2;
+                    // Adjust edges to parents: get more if we liked what they did, less otherwise
+                    edge.width += edge_adjustment_factor * modified_feedback;
 
-                        // Adjust edges to parents: get more if we liked what they did, less otherwise
-                        edges[parent_idx][i].width += edge_adjustment_factor * modified_feedback;
+                    // Send sign adjusted feedback to the parent at the time it fired
+                    sent[pc] += modified_feedback; });
 
-                        // Add parents to new frontier with sign adjusted feedback
-                        frontier_buf[parent_idx][parent_fired_time] += modified_feedback;
-                    }
+                // Give feedback for not firing, one time point earlier as long as it is still tracked
+                if (!parent_did_fire && c + 1 < w)
+                {
+                    const float gamma = discount[c + 1];
 
-                    if (!parent_did_fire)
+                    if (fabs(gamma * r2) >= 1e-6)
                     {
-                        // Give feedback for not firing
-                        const float target_time = t2 - 1;
-                        const float gamma = pow(temporal_discount_factor, t - target_time);
-
-                        if (fabs(gamma * r2) < 1e-6)
-                        {
-                            // Determine whether we like that the parent did not fire at us (value these "contributions" relatively less)
-                            const float parent_contributed = did_fire ? -1 : 1;
-                            const float modified_feedback = gamma * not_fired_contribution_factor * parent_contributed * r2;
-
-                            // Add parents to new frontier with sign adjusted feedback
-                            frontier_buf[parent_idx][target_time] += modified_feedback;
-                        }
-                    }
-                }
+                        // Determine whether we like that the parent did not fire at us (value these "contributions" relatively less)
+                        const float parent_contributed = did_fire ? -1 : 1;
+                        const float modified_feedback = gamma * not_fired_contribution_factor * parent_contributed * r2;
 
-                // This value  tracks whether the node has mostly had positive or negative feedback lately
-                // Typical amounts are in magnitude 1e-3 ish?
-                const float feedback_sign = ((r2 > 0) - (r2 < 0));
-                nodes[i].modification_tracker = modification_tracker_increment * feedback_sign + (1 - modification_tracker_increment) * nodes[i].modification_tracker;
-
-                // Something like marking the node as sad if it gets negative feeback for not firing and didn't have any incoming energy
-                const bool make_sad = r2 < 0 && !any_active_parents && !did_fire;
-                if (make_sad)
-                {
-                    nodes[i].sadness = sadness_increment + (1 - sadness_increment) * nodes[i].sadness;
+                        sent[c + 1] += modified_feedback;
+                    }
                 }
             }
-        }
 
-        frontier = frontier_buf;
+            // This value  tracks whether the node has mostly had positive or negative feedback lately
+            // Typical amounts are in magnitude 1e-3 ish?
+            const float feedback_sign = ((r2 > 0) - (r2 < 0));
+            nodes[i].modification_tracker = modification_tracker_increment * feedback_sign + (1 - modification_tracker_increment) * nodes[i].modification_tracker;
 
-        offset_time--;
-        if (offset_time >= t - track_length)
-        {
-            const float gamma = pow(temporal_discount_factor, t - offset_time);
-
-            // Add output nodes to frontier with a time offset
-            for (node_index i = d_in; i < d_in + d_out; i++)
+            // Something like marking the node as sad if it gets negative feeback for not firing and didn't have any incoming energy
+            const bool make_sad = r2 < 0 && !any_active_parents && !did_fire;
+            if (make_sad)
             {
-                frontier[i][offset_time] = gamma * r;
+                nodes[i].sadness = sadness_increment + (1 - sadness_increment) * nodes[i].sadness;
             }
         }
     }
@@ -498,7 +524,7 @@ void Brain::feedback(float r)
         }
 
         // Add a new edge with small probability if we are an active node with few edges
-        const float rate_of_fire = nodes[i].fired_at.size() / (float)track_length;
+        const float rate_of_fire = spikes.count(i) / (float)track_length;
         float p_add = 0.1 * (1 - edges[i].size() / (float)connectivity) * rate_of_fire;
         if (edges[i].empty())
         {
@@ -543,7 +569,6 @@ void Brain::feedback(float r)
 
 void Brain::initialize(int connection_depth)
 {
-    pair<node_index, node_index> input_range = {0, d_in - 1};
     pair<node_index, node_index> output_range = {d_in, d_in + d_out - 1};
     int attempts = 0;
 
@@ -574,13 +599,17 @@ void Brain::initialize(int connection_depth)
         }
 #endif
         // This is just a sanity check as create_edges should guarantee correct connections
-    } while (!(failed || (test_connectivity(input_range, output_range, connection_depth) && test_connectivity(input_range, make_pair(d_in, n - 1)))));
+    } while (failed || !reach.disconnected(output_range, connection_depth).empty() || !reach.disconnected(make_pair(d_in, n - 1)).empty());
 
     for (node_index i = 0; i < n; i++)
     {
         nodes[i].energy_uptake = random_float(0, 0.1);
         nodes[i].firepower = random_float(0.1, 2);
     }
+
+    // Stale as soon as feedback removes an edge
+    reach = Reachability();
+    layout_dirty = true;
 }
 
 // Called after update, checks which output nodes fired at the last time point
@@ -589,7 +618,7 @@ vector<bool> Brain::get_output() const
     vector<bool> res(d_out);
     for (node_index i = d_in; i < d_in + d_out; i++)
     {
-        res[i - d_in] = !nodes[i].fired_at.empty() && nodes[i].fired_at.back() == t;
+        res[i - d_in] = spikes.did_fire_at(i, t);
     }
     return res;
 }
@@ -598,7 +627,7 @@ void Brain::set_input(vector<bool> x)
 {
     for (node_index k = 0; k < d_in; k++)
     {
-        nodes[k].energy = x[k];
+        energy[k] = x[k];
     }
 }
 
@@ -610,7 +639,7 @@ Maybe passive nodes can dissappear?
 Output is calculated by running some number of iterations after a new input ..?
 */
 
-Brain::Brain(int _n, int _connectivity, int _d_in, int _d_out, int track_l)
+Brain::Brain(int _n, int _connectivity, int _d_in, int _d_out, int track_l) : spikes(_n, track_l)
 {
     if (_n < 2)
     {
@@ -628,4 +657,161 @@ Brain::Brain(int _n, int _connectivity, int _d_in, int _d_out, int track_l)
     p_change_type = pow(10, random_float(-2, 0));
     nodes.resize(n);
     edges.resize(n);
+    energy.assign(n, 0);
+    inhibition.assign(n, 0);
+    energy_buf.assign(n, 0);
+    inhibition_buf.assign(n, 0);
+    layout_dirty = true;
+}
+
+const uint32_t snapshot_magic = 0x53425253; // "SRBS"
+const uint32_t snapshot_version = 1;
+
+// Binary snapshot of everything needed to continue the brain exactly where it is: sizes, hyperparameters, node
+// parameters and state, edges and the spike history. Values are in native layout, so a snapshot is meant to be
+// read on the same kind of machine, for example by memory mapping a checkpoint file.
+string Brain::snapshot() const
+{
+    ByteWriter w;
+    w.put(snapshot_magic);
+    w.put(snapshot_version);
+    w.put<int32_t>(n);
+    w.put<int32_t>(d_in);
+    w.put<int32_t>(d_out);
+    w.put<int32_t>(connectivity);
+    w.put<int32_t>(t);
+    w.put<int32_t>(track_length);
+    w.put(chill_factor_base);
+    w.put(temporal_discount_factor);
+    w.put(p_change_type);
+
+    for (auto &x : nodes)
+    {
+        w.put(x.energy_uptake);
+        w.put(x.firepower);
+        w.put(x.modification_tracker);
+        w.put(x.sadness);
+    }
+    w.put_array(energy.data(), n);
+    w.put_array(inhibition.data(), n);
+
+    // Parents are rebuilt from the edges, in the order the edges are stored
+    int64_t edge_count = 0;
+    for (auto &x : edges)
+    {
+        edge_count += x.size();
+    }
+    w.put(edge_count);
+    for (node_index i = 0; i < n; i++)
+    {
+        for (auto &x : edges[i])
+        {
+            w.put<int32_t>(i);
+            w.put<int32_t>(x.first);
+            w.put(x.second.width);
+            w.put<int32_t>(x.second.is_inhibitor);
+        }
+    }
+
+    w.put_array(spikes.bits.data(), spikes.bits.size());
+    return w.buf;
+}
+
+// Copy the state of the brain, but not the layout: in_edge would point into the edges of other
+Brain::Brain(const Brain &other) : spikes(other.spikes)
+{
+    *this = other;
+}
+
+Brain &Brain::operator=(const Brain &other)
+{
+    if (this == &other)
+    {
+        return *this;
+    }
+
+    n = other.n;
+    d_in = other.d_in;
+    d_out = other.d_out;
+    connectivity = other.connectivity;
+    t = other.t;
+    track_length = other.track_length;
+    nodes = other.nodes;
+    edges = other.edges;
+    chill_factor_base = other.chill_factor_base;
+    temporal_discount_factor = other.temporal_discount_factor;
+    p_change_type = other.p_change_type;
+    energy = other.energy;
+    inhibition = other.inhibition;
+    energy_buf = other.energy_buf;
+    inhibition_buf = other.inhibition_buf;
+    spikes = other.spikes;
+    reach = other.reach;
+
+    in_edge.clear();
+    layout_dirty = true;
+    return *this;
+}
+
+// Restore a brain from a snapshot, without touching the random engine
+Brain::Brain(const char *data, size_t size) : spikes(0, 0)
+{
+    ByteReader r(data, size);
+    if (r.get<uint32_t>() != snapshot_magic || r.get<uint32_t>() != snapshot_version)
+    {
+        throw runtime_error("Not a brain snapshot of a supported version!");
+    }
+
+    n = r.get<int32_t>();
+    d_in = r.get<int32_t>();
+    d_out = r.get<int32_t>();
+    connectivity = r.get<int32_t>();
+    t = r.get<int32_t>();
+    track_length = r.get<int32_t>();
+    chill_factor_base = r.get<float>();
+    temporal_discount_factor = r.get<float>();
+    p_change_type = r.get<float>();
+
+    if (n < 2 || track_length < 0 || d_in < 0 || d_out < 0 || d_in + d_out > n)
+    {
+        throw runtime_error("Invalid brain snapshot!");
+    }
+
+    nodes.resize(n);
+    for (auto &x : nodes)
+    {
+        x.energy_uptake = r.get<float>();
+        x.firepower = r.get<float>();
+        x.modification_tracker = r.get<float>();
+        x.sadness = r.get<float>();
+    }
+
+    energy.resize(n);
+    inhibition.resize(n);
+    r.get_array(energy.data(), n);
+    r.get_array(inhibition.data(), n);
+    energy_buf.assign(n, 0);
+    inhibition_buf.assign(n, 0);
+
+    edges.resize(n);
+    const int64_t edge_count = r.get<int64_t>();
+    for (int64_t k = 0; k < edge_count; k++)
+    {
+        const node_index i = r.get<int32_t>();
+        const node_index j = r.get<int32_t>();
+        if (i < 0 || i >= n || j < 0 || j >= n)
+        {
+            throw runtime_error("Invalid edge in brain snapshot!");
+        }
+
+        Edge &e = edges[i][j];
+        e.width = r.get<float>();
+        e.is_inhibitor = r.get<int32_t>();
+        nodes[j].parents.push_back(i);
+    }
+
+    spikes = SpikeHistory(n, track_length);
+    spikes.t = t;
+    r.get_array(spikes.bits.data(), spikes.bits.size());
+    layout_dirty = true;
 }
@@ -5,9 +5,12 @@
 #include <functional>
 #include <vector>
 #include <map>
+#include <string>
 
 #include "node.hpp"
 #include "edge.hpp"
+#include "reachability.hpp"
+#include "spike_history.hpp"
 #include "util.hpp"
 
 struct Brain
@@ -23,6 +26,33 @@ struct Brain
     float temporal_discount_factor;
     float p_change_type;
 
+    // Per tick state, double buffered so update reads one array and writes the other
+    std::vector<float> energy, inhibition;
+    std::vector<float> energy_buf, inhibition_buf;
+    SpikeHistory spikes;
+
+    // Incoming edges per target node in CSR layout, sorted by source node so sums are accumulated in the
+    // same order as walking edges by source. Rebuilt from edges and nodes by update when layout_dirty is set.
+    bool layout_dirty;
+    std::vector<int> in_offset;
+    std::vector<node_index> in_source;
+    std::vector<float> in_excite, in_inhibit;
+    std::vector<float> node_uptake, node_firepower;
+    std::vector<float> transmitted;
+
+    // Feedback sweep state: direct references to the incoming edges, the incoming edge positions listed by
+    // source node, and per incoming edge the feedback sent back to its source at each time offset t - s.
+    // in_edge points into this brain's own edge maps, so copies leave the layout out and rebuild it.
+    std::vector<Edge *> in_edge;
+    std::vector<int> out_offset;
+    std::vector<int> out_slot;
+    std::vector<float> edge_feedback;
+    std::vector<float> discount;
+
+    // Reachability from the input nodes while initialize builds the graph, kept up to date by add_edge. Feedback
+    // removes edges later, so it is cleared at the end of initialize and add_edge skips it from then on.
+    Reachability reach;
+
     std::set<node_index> find_disconnected_nodes(std::pair<node_index, node_index> range1, std::pair<node_index, node_index> range2, int max_depth = 0) const;
     bool test_connectivity(std::pair<node_index, node_index> range1, std::pair<node_index, node_index> range2, int max_depth = 0) const;
     void normalize_edges();
@@ -30,6 +60,7 @@ struct Brain
     void add_edge(node_index i, node_index j);
     node_index random_walk(std::pair<node_index, node_index> start_range, int steps, std::function<std::vector<node_index>(node_index)> option_selector) const;
     void create_edges(int connectivity, int connection_depth);
+    void rebuild_layout();
     void update();
     void feedback_frontier(float r);
     void feedback(float r);
@@ -38,5 +69,11 @@ struct Brain
     void set_input(std::vector<bool> x);
     bool is_input_node(node_index idx) const;
     bool is_output_node(node_index idx) const;
+    std::string snapshot() const;
     Brain(int _n, int _connectivity, int _d_in, int _d_out, int track_l);
+    Brain(const char *data, size_t size);
+    Brain(const Brain &other);
+    Brain(Brain &&other) = default;
+    Brain &operator=(const Brain &other);
+    Brain &operator=(Brain &&other) = default;
 };
\ No newline at end of file
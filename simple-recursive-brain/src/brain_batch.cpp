@@ -0,0 +1,345 @@
+#include "brain_batch.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+BrainBatch::BrainBatch(vector<Brain *> _brains)
+{
+    if (_brains.empty())
+    {
+        throw runtime_error("A brain batch needs at least one brain!");
+    }
+
+    brains = _brains;
+    lanes = brains.size();
+    n = brains[0]->n;
+    for (auto b : brains)
+    {
+        if (b->n != n || b->d_in != brains[0]->d_in || b->d_out != brains[0]->d_out || b->track_length != brains[0]->track_length)
+        {
+            throw runtime_error("All brains in a batch must have the same size!");
+        }
+    }
+
+    energy.resize(n * lanes);
+    inhibition.resize(n * lanes);
+    energy_buf.resize(n * lanes);
+    inhibition_buf.resize(n * lanes);
+    transmitted.resize(n * lanes);
+    energy_in.resize(lanes);
+    inhibition_in.resize(lanes);
+
+    rebuild_layout();
+    load();
+}
+
+// Interleave the incoming edges and node parameters of all brains, refreshing the layout of brains that changed.
+// Rows may be assigned to different nodes afterwards, so the state has to be stored before and loaded after.
+void BrainBatch::rebuild_layout()
+{
+    node_of.resize(n * lanes);
+    row_of.resize(n * lanes);
+    vector<node_index> order;
+    for (int b = 0; b < lanes; b++)
+    {
+        if (brains[b]->layout_dirty)
+        {
+            brains[b]->rebuild_layout();
+        }
+
+        sort_lane(b, order);
+        for (int r = 0; r < n; r++)
+        {
+            node_of[r * lanes + b] = order[r];
+            row_of[b * n + order[r]] = r;
+        }
+    }
+
+    // The slots of a row are the most edges any of its nodes has, as every lane is sorted they do not increase
+    slot_offset.assign(n + 1, 0);
+    for (int r = 0; r < n; r++)
+    {
+        int slots = 0;
+        for (int b = 0; b < lanes; b++)
+        {
+            slots = max(slots, degree(b, node_of[r * lanes + b]));
+        }
+        slot_offset[r + 1] = slot_offset[r] + slots;
+    }
+
+    const size_t total = (size_t)slot_offset[n] * lanes;
+    slot_source.resize(total);
+    slot_excite.resize(total);
+    slot_inhibit.resize(total);
+    uptake.resize(n * lanes);
+    firepower.resize(n * lanes);
+
+    lane_offset.resize(lanes);
+    lane_source.resize(lanes);
+    lane_slot.resize(lanes);
+    for (int b = 0; b < lanes; b++)
+    {
+        fill_lane(b);
+    }
+}
+
+int BrainBatch::degree(int lane, node_index i) const
+{
+    return brains[lane]->in_offset[i + 1] - brains[lane]->in_offset[i];
+}
+
+// Counting sort of a brain's nodes by decreasing in-degree, ties in node order
+void BrainBatch::sort_lane(int lane, vector<node_index> &order) const
+{
+    int max_degree = 0;
+    for (node_index i = 0; i < n; i++)
+    {
+        max_degree = max(max_degree, degree(lane, i));
+    }
+
+    vector<int> first_row(max_degree + 2);
+    for (node_index i = 0; i < n; i++)
+    {
+        first_row[max_degree - degree(lane, i) + 1]++;
+    }
+    for (int d = 0; d <= max_degree; d++)
+    {
+        first_row[d + 1] += first_row[d];
+    }
+
+    order.resize(n);
+    for (node_index i = 0; i < n; i++)
+    {
+        order[first_row[max_degree - degree(lane, i)]++] = i;
+    }
+}
+
+// Sort a brain whose edges changed into the rows again without touching the other lanes, false if a node ends up
+// with more edges than its row has slots
+bool BrainBatch::relayout_lane(int lane)
+{
+    vector<node_index> order;
+    sort_lane(lane, order);
+    for (int r = 0; r < n; r++)
+    {
+        if (degree(lane, order[r]) > slot_offset[r + 1] - slot_offset[r])
+        {
+            return false;
+        }
+    }
+
+    store_lane(lane);
+    for (int r = 0; r < n; r++)
+    {
+        node_of[r * lanes + lane] = order[r];
+        row_of[lane * n + order[r]] = r;
+    }
+    fill_lane(lane);
+    load_lane(lane);
+    return true;
+}
+
+// Write the incoming edges of a brain to the slots of its rows, padding each row with zero weights
+void BrainBatch::fill_lane(int lane)
+{
+    const Brain &x = *brains[lane];
+    lane_offset[lane] = x.in_offset;
+    lane_source[lane] = x.in_source;
+    lane_slot[lane].resize(x.in_source.size());
+    for (int r = 0; r < n; r++)
+    {
+        const node_index i = node_of[r * lanes + lane];
+        for (int s = 0; s < slot_offset[r + 1] - slot_offset[r]; s++)
+        {
+            const int pos = (slot_offset[r] + s) * lanes + lane;
+            if (s < degree(lane, i))
+            {
+                slot_source[pos] = row_of[lane * n + x.in_source[x.in_offset[i] + s]] * lanes + lane;
+                lane_slot[lane][x.in_offset[i] + s] = pos;
+            }
+            else
+            {
+                // Padding reads the lane's own first row
+                slot_source[pos] = lane;
+                slot_excite[pos] = 0;
+                slot_inhibit[pos] = 0;
+            }
+        }
+    }
+    refresh_weights(lane);
+}
+
+// Copy edge weights and node parameters of a brain whose edges are laid out as they were
+void BrainBatch::refresh_weights(int lane)
+{
+    const Brain &x = *brains[lane];
+    for (size_t k = 0; k < x.in_source.size(); k++)
+    {
+        slot_excite[lane_slot[lane][k]] = x.in_excite[k];
+        slot_inhibit[lane_slot[lane][k]] = x.in_inhibit[k];
+    }
+
+    for (int r = 0; r < n; r++)
+    {
+        const node_index i = node_of[r * lanes + lane];
+        uptake[r * lanes + lane] = x.node_uptake[i];
+        firepower[r * lanes + lane] = x.node_firepower[i];
+    }
+}
+
+// Run one increment of the simulation for all brains, with the same results as Brain::update on each of them
+// Lane kernels, compiled for AVX-512 and AVX2 next to the baseline and picked for the cpu when the program loads.
+// The baseline has no gather, so the edge loop only vectorizes well with AVX2 and up.
+#define LANE_KERNEL __attribute__((target_clones("avx512f", "avx2", "default")))
+
+// Firing over the state of all rows and lanes at once
+LANE_KERNEL static void fire_lanes(int count, const float *e, const float *h, const float *firepower, float *transmitted, float *e_out, float *h_out)
+{
+#pragma omp simd
+    for (int k = 0; k < count; k++)
+    {
+        const bool was_inhibited = h[k] >= 1;
+        const bool fired = e[k] >= 1 && !was_inhibited;
+
+        transmitted[k] = fired ? firepower[k] : 0;
+        e_out[k] = fired ? 0 : e[k];
+        h_out[k] = was_inhibited ? 0 : h[k];
+    }
+}
+
+// Sums of transmitted energy over the padded incoming edges of each row, in the same order as Brain::update.
+// e_in and h_in hold the sums of one row.
+LANE_KERNEL static void gather_lanes(int n, int lanes, const int *slot_offset, const node_index *slot_source, const float *slot_excite, const float *slot_inhibit,
+                                     const float *transmitted, const float *uptake, float *e_out, float *h_out, float *e_in, float *h_in)
+{
+    for (int j = 0; j < n; j++)
+    {
+        for (int b = 0; b < lanes; b++)
+        {
+            e_in[b] = 0;
+            h_in[b] = 0;
+        }
+
+        for (int k = slot_offset[j]; k < slot_offset[j + 1]; k++)
+        {
+            const node_index *src = slot_source + (size_t)k * lanes;
+            const float *ex = slot_excite + (size_t)k * lanes;
+            const float *ih = slot_inhibit + (size_t)k * lanes;
+
+#pragma omp simd
+            for (int b = 0; b < lanes; b++)
+            {
+                const float x = transmitted[src[b]];
+                e_in[b] += x * ex[b];
+                h_in[b] += x * ih[b];
+            }
+        }
+
+        float *e = e_out + (size_t)j * lanes;
+        float *h = h_out + (size_t)j * lanes;
+        const float *u = uptake + (size_t)j * lanes;
+#pragma omp simd
+        for (int b = 0; b < lanes; b++)
+        {
+            e[b] += e_in[b] + u[b];
+            h[b] += h_in[b];
+        }
+    }
+}
+
+void BrainBatch::update()
+{
+    bool moved = false;
+    for (int b = 0; b < lanes; b++)
+    {
+        Brain &x = *brains[b];
+        if (x.layout_dirty)
+        {
+            x.rebuild_layout();
+            if (x.in_offset == lane_offset[b] && x.in_source == lane_source[b])
+            {
+                refresh_weights(b);
+            }
+            else if (!relayout_lane(b))
+            {
+                moved = true;
+            }
+        }
+    }
+
+    if (moved)
+    {
+        store();
+        rebuild_layout();
+        load();
+    }
+
+    for (auto b : brains)
+    {
+        b->t++;
+        b->spikes.advance(b->t);
+    }
+
+    // Identify fired nodes, reset energy on fired nodes and inhibition on inhibited nodes
+    fire_lanes(n * lanes, energy.data(), inhibition.data(), firepower.data(), transmitted.data(), energy_buf.data(), inhibition_buf.data());
+    for (int k = 0; k < n * lanes; k++)
+    {
+        if (energy[k] >= 1 && inhibition[k] < 1)
+        {
+            brains[k % lanes]->spikes.set_fired(node_of[k]);
+        }
+    }
+
+    // Gather transmitted energy through incoming edges and add energy uptake
+    gather_lanes(n, lanes, slot_offset.data(), slot_source.data(), slot_excite.data(), slot_inhibit.data(), transmitted.data(), uptake.data(), energy_buf.data(), inhibition_buf.data(), energy_in.data(), inhibition_in.data());
+
+    // Update state
+    energy.swap(energy_buf);
+    inhibition.swap(inhibition_buf);
+}
+
+void BrainBatch::set_input(int lane, const vector<bool> &x)
+{
+    for (node_index k = 0; k < brains[lane]->d_in; k++)
+    {
+        energy[row_of[lane * n + k] * lanes + lane] = x[k];
+    }
+}
+
+// Copy energy and inhibition back to the brains, for example before saving a snapshot
+void BrainBatch::store()
+{
+    for (int b = 0; b < lanes; b++)
+    {
+        store_lane(b);
+    }
+}
+
+// Take energy and inhibition from the brains, for example after they were changed outside the batch
+void BrainBatch::load()
+{
+    for (int b = 0; b < lanes; b++)
+    {
+        load_lane(b);
+    }
+}
+
+void BrainBatch::store_lane(int lane)
+{
+    for (int r = 0; r < n; r++)
+    {
+        brains[lane]->energy[node_of[r * lanes + lane]] = energy[r * lanes + lane];
+        brains[lane]->inhibition[node_of[r * lanes + lane]] = inhibition[r * lanes + lane];
+    }
+}
+
+void BrainBatch::load_lane(int lane)
+{
+    for (int r = 0; r < n; r++)
+    {
+        energy[r * lanes + lane] = brains[lane]->energy[node_of[r * lanes + lane]];
+        inhibition[r * lanes + lane] = brains[lane]->inhibition[node_of[r * lanes + lane]];
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "brain.hpp"
+#include "util.hpp"
+
+// Steps B brains of the same size in lockstep. Per node state is lane interleaved, row r of brain b at r * B + b,
+// so the firing and gathering loops run across brains in SIMD lanes. Each brain keeps its own edges: incoming edges
+// are padded per row to the largest in-degree over the brains, with zero weights for the missing ones, which leaves
+// the sums of every brain in the same order as Brain::update. Nodes of each brain are placed in rows by decreasing
+// in-degree, so the in-degrees in a row are close and little padding is needed.
+// The firing and gathering kernels are cloned for AVX-512 and AVX2, whose gathers the edge loop needs to vectorize.
+// Spikes and t are written to the brains as they happen, so output and feedback work on the brains directly.
+// Energy and inhibition live here until store copies them back.
+struct BrainBatch
+{
+    int lanes;
+    int n;
+    std::vector<Brain *> brains;
+
+    std::vector<float> energy, inhibition;
+    std::vector<float> energy_buf, inhibition_buf;
+    std::vector<float> uptake, firepower, transmitted;
+    std::vector<float> energy_in, inhibition_in;
+
+    // Node of brain b in row r at r * B + b, and the row of node i of brain b at b * n + i
+    std::vector<node_index> node_of;
+    std::vector<int> row_of;
+
+    // Padded incoming edges in CSR layout over slots, with slot k of lane b at k * B + b, sources are indices into
+    // the interleaved state
+    std::vector<int> slot_offset;
+    std::vector<node_index> slot_source;
+    std::vector<float> slot_excite, slot_inhibit;
+
+    // Incoming edges of each brain as last laid out, and the slot each of them went to. Feedback changes weights far
+    // more often than edges, so a brain whose edges are the same only has its weights copied again, and a brain that
+    // gained edges is sorted into the rows again on its own as long as they have room.
+    std::vector<std::vector<int>> lane_offset;
+    std::vector<std::vector<node_index>> lane_source;
+    std::vector<std::vector<int>> lane_slot;
+
+    BrainBatch(std::vector<Brain *> _brains);
+
+    void rebuild_layout();
+    int degree(int lane, node_index i) const;
+    void sort_lane(int lane, std::vector<node_index> &order) const;
+    bool relayout_lane(int lane);
+    void fill_lane(int lane);
+    void refresh_weights(int lane);
+    void update();
+    void set_input(int lane, const std::vector<bool> &x);
+    void store();
+    void load();
+    void store_lane(int lane);
+    void load_lane(int lane);
+};
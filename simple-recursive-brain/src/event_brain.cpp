@@ -0,0 +1,343 @@
+#include "event_brain.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// Add u to e k times with float rounding at every step, like k ticks without input in Brain::update, stopping early
+// once e reaches 1 if stop is set. Returns the number of additions done.
+// While e stays in one binade every addition rounds u to the same number d of the binade's ulps, so the additions up
+// to the next binade are done at once on the mantissa and the result is the same as adding one at a time.
+static long idle_add(float &e, float u, long k, bool stop)
+{
+    if (u == 0)
+    {
+        return k;
+    }
+    if (u < 0)
+    {
+        // Energy only goes down, and adding -u to -e rounds the same as adding u to e
+        if (stop)
+        {
+            return k;
+        }
+        e = -e;
+        idle_add(e, -u, k, false);
+        e = -e;
+        return k;
+    }
+
+    uint32_t ub;
+    memcpy(&ub, &u, 4);
+    const int u_exp = max<int>(ub >> 23, 1);
+    const uint32_t u_mant = (ub & 0x7fffff) | (ub >> 23 ? 0x800000 : 0);
+
+    long done = 0;
+    while (done < k && !(stop && e >= 1))
+    {
+        uint32_t eb;
+        memcpy(&eb, &e, 4);
+        const int e_exp = eb >> 23;
+        const int shift = e_exp - u_exp;
+        if (e > 0 && e_exp >= 1 && e_exp < 255 && shift > -8)
+        {
+            // u in ulps of e rounded to nearest, on a tie the rounding depends on e so those are added one at a time
+            uint64_t d = 0;
+            bool tie = false;
+            if (shift <= 0)
+            {
+                d = (uint64_t)u_mant << -shift;
+            }
+            else if (shift < 25)
+            {
+                const uint32_t rem = u_mant & ((1u << shift) - 1);
+                const uint32_t half = 1u << (shift - 1);
+                d = (u_mant >> shift) + (rem > half);
+                tie = rem == half;
+            }
+
+            if (d == 0 && !tie)
+            {
+                return k;
+            }
+
+            // Every addition with mantissa + d + 1 below 2^24 ends in the binade at mantissa + d
+            const uint64_t top = 1 << 24;
+            const uint64_t m = (eb & 0x7fffff) | 0x800000;
+            const long j = !tie && m + d + 1 < top ? min<long>((top - 1 - d - m) / d, k - done) : 0;
+            if (j > 0)
+            {
+                eb = (e_exp << 23) | ((m + j * d) & 0x7fffff);
+                memcpy(&e, &eb, 4);
+                done += j;
+                continue;
+            }
+        }
+
+        // Once an addition leaves e as it is, so do all the others
+        const float next = e + u;
+        if (next == e)
+        {
+            return k;
+        }
+        e = next;
+        done++;
+    }
+    return done;
+}
+
+EventBrain::EventBrain(Brain *_brain)
+{
+    brain = _brain;
+    n = brain->n;
+
+    energy.resize(n);
+    inhibition.resize(n);
+    stamp.resize(n);
+    next_event.resize(n);
+    is_visited.assign(n, 0);
+    energy_in.assign(n, 0);
+    inhibition_in.assign(n, 0);
+
+    if (brain->layout_dirty)
+    {
+        brain->rebuild_layout();
+    }
+    uptake = brain->node_uptake;
+    rebuild_layout();
+    load();
+}
+
+// Take node parameters and outgoing edges from the brain, rebuilding its layout first if needed
+void EventBrain::rebuild_layout()
+{
+    if (brain->layout_dirty)
+    {
+        brain->rebuild_layout();
+    }
+
+    // Nodes whose uptake changed are brought up to now with the old uptake and queued again with the new one
+    for (node_index i = 0; i < n; i++)
+    {
+        if (uptake[i] != brain->node_uptake[i])
+        {
+            catch_up(i, brain->t);
+            uptake[i] = brain->node_uptake[i];
+            schedule(i);
+        }
+    }
+    firepower = brain->node_firepower;
+
+    // Counting sort of the incoming edges by source
+    out_offset.assign(n + 1, 0);
+    for (int k = 0; k < brain->in_offset[n]; k++)
+    {
+        out_offset[brain->in_source[k] + 1]++;
+    }
+    for (node_index i = 0; i < n; i++)
+    {
+        out_offset[i + 1] += out_offset[i];
+    }
+
+    out_target.resize(brain->in_offset[n]);
+    out_excite.resize(brain->in_offset[n]);
+    out_inhibit.resize(brain->in_offset[n]);
+    vector<int> cursor(out_offset.begin(), out_offset.end() - 1);
+    for (node_index j = 0; j < n; j++)
+    {
+        for (int k = brain->in_offset[j]; k < brain->in_offset[j + 1]; k++)
+        {
+            const int pos = cursor[brain->in_source[k]]++;
+            out_target[pos] = j;
+            out_excite[pos] = brain->in_excite[k];
+            out_inhibit[pos] = brain->in_inhibit[k];
+        }
+    }
+}
+
+// Add the uptake of the ticks after stamp[i] up to tick s
+void EventBrain::catch_up(node_index i, time_point s)
+{
+    idle_add(energy[i], uptake[i], s - stamp[i], false);
+    stamp[i] = s;
+}
+
+// Queue the next tick at which node i fires or has its inhibition reset if it gets no input before then. When that
+// is far off a lower bound is queued instead and the node is queued again from there. The bound holds while the
+// energy stays in (-1, 1), where every addition of the uptake adds at most u + 2^-25. Below -1 the rounding error
+// is larger, so the node is stepped through 32 ticks at a time until it is above -1.
+void EventBrain::schedule(node_index i)
+{
+    next_event[i] = -1;
+    if (energy[i] >= 1 || inhibition[i] >= 1)
+    {
+        next_event[i] = stamp[i] + 1;
+    }
+    else if (uptake[i] > 0)
+    {
+        const double bound = energy[i] > -1 ? min((1.0 - energy[i]) / (uptake[i] + 0x1p-25) - 1, (double)(1 << 30)) : 0;
+        if (bound >= 16)
+        {
+            next_event[i] = stamp[i] + 1 + (long)bound;
+        }
+        else
+        {
+            // Either the tick it fires, or the tick to look again if it is still on its way up
+            float e = energy[i];
+            const long k = idle_add(e, uptake[i], 32, true);
+            if (e >= 1 || e != energy[i])
+            {
+                next_event[i] = stamp[i] + 1 + k;
+            }
+        }
+    }
+
+    if (next_event[i] >= 0)
+    {
+        events.push({next_event[i], i});
+    }
+}
+
+// Bring node i up to the start of the current tick and add it to the nodes visited in it
+void EventBrain::visit(node_index i)
+{
+    if (!is_visited[i])
+    {
+        catch_up(i, brain->t - 1);
+        is_visited[i] = 1;
+        visited.push_back(i);
+    }
+}
+
+// Run one increment of the simulation, with the same results as Brain::update
+void EventBrain::update()
+{
+    if (brain->layout_dirty)
+    {
+        rebuild_layout();
+    }
+
+    brain->t++;
+    vector<node_index> &ring = fired_at[brain->t % fired_at.size()];
+    brain->spikes.advance(brain->t, ring);
+
+    // Visit the nodes due this tick, nodes queued on a lower bound that are not over the threshold yet are queued again
+    while (!events.empty() && events.top().first <= brain->t)
+    {
+        const auto [s, i] = events.top();
+        events.pop();
+        if (next_event[i] != s)
+        {
+            continue;
+        }
+
+        catch_up(i, brain->t - 1);
+        if (energy[i] >= 1 || inhibition[i] >= 1)
+        {
+            visit(i);
+        }
+        else
+        {
+            schedule(i);
+        }
+    }
+
+    // Identify fired nodes, reset energy on fired nodes and inhibition on inhibited nodes
+    fired.clear();
+    for (node_index i : visited)
+    {
+        const bool was_inhibited = inhibition[i] >= 1;
+        if (energy[i] >= 1 && !was_inhibited)
+        {
+            energy[i] = 0;
+            fired.push_back(i);
+            brain->spikes.set_fired(i);
+        }
+        if (was_inhibited)
+        {
+            inhibition[i] = 0;
+        }
+    }
+
+    // Send transmitted energy along outgoing edges, by increasing source so every target sums in the same order as
+    // its incoming edges in Brain::update
+    sort(fired.begin(), fired.end());
+    ring = fired;
+    for (node_index i : fired)
+    {
+        const float x = firepower[i];
+        for (int k = out_offset[i]; k < out_offset[i + 1]; k++)
+        {
+            const node_index j = out_target[k];
+            visit(j);
+            energy_in[j] += x * out_excite[k];
+            inhibition_in[j] += x * out_inhibit[k];
+        }
+    }
+
+    // Update state of the visited nodes, the others add their uptake when they are next visited
+    for (node_index j : visited)
+    {
+        energy[j] += energy_in[j] + uptake[j];
+        inhibition[j] += inhibition_in[j];
+        energy_in[j] = 0;
+        inhibition_in[j] = 0;
+        stamp[j] = brain->t;
+        is_visited[j] = 0;
+        schedule(j);
+    }
+    visited.clear();
+
+    // Drop stale queue entries once they outnumber the nodes
+    if (events.size() > 2 * n + 64)
+    {
+        events = {};
+        for (node_index i = 0; i < n; i++)
+        {
+            if (next_event[i] >= 0)
+            {
+                events.push({next_event[i], i});
+            }
+        }
+    }
+}
+
+void EventBrain::set_input(const vector<bool> &x)
+{
+    for (node_index k = 0; k < brain->d_in; k++)
+    {
+        energy[k] = x[k];
+        stamp[k] = brain->t;
+        schedule(k);
+    }
+}
+
+// Bring all nodes up to the current tick and copy energy and inhibition back to the brain
+void EventBrain::store()
+{
+    for (node_index i = 0; i < n; i++)
+    {
+        catch_up(i, brain->t);
+        brain->energy[i] = energy[i];
+        brain->inhibition[i] = inhibition[i];
+    }
+}
+
+// Take energy, inhibition and spikes from the brain and queue every node again
+void EventBrain::load()
+{
+    const int w = brain->track_length + 1;
+    fired_at.assign(w, {});
+    events = {};
+    for (node_index i = 0; i < n; i++)
+    {
+        energy[i] = brain->energy[i];
+        inhibition[i] = brain->inhibition[i];
+        stamp[i] = brain->t;
+        schedule(i);
+
+        brain->spikes.for_each_fired(i, brain->t - brain->track_length, brain->t, [&](time_point s)
+                                     { fired_at[(s % w + w) % w].push_back(i); });
+    }
+}
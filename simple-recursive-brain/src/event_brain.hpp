@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "brain.hpp"
+#include "util.hpp"
+
+// Event driven update of a brain with the same spikes and state as Brain::update. A tick only visits the nodes that
+// fire or have their inhibition reset, and the targets of the nodes that fired. A node that gets no input just adds
+// its uptake every tick, so the uptake is added when the node is next visited, and the tick at which the uptake alone
+// takes it over the threshold is worked out ahead and queued.
+// Spikes and t are written to the brain as they happen, energy and inhibition live here until store copies them back.
+// Changes that feedback makes to edges and uptake are picked up through layout_dirty, other changes to the state of
+// the brain need a load.
+struct EventBrain
+{
+    Brain *brain;
+    int n;
+
+    // State of node i after tick stamp[i]
+    std::vector<float> energy, inhibition;
+    std::vector<time_point> stamp;
+    std::vector<float> uptake, firepower;
+
+    // Outgoing edges per source node with their targets and weights
+    std::vector<int> out_offset;
+    std::vector<node_index> out_target;
+    std::vector<float> out_excite, out_inhibit;
+
+    // Tick at which each node next has to be visited, or -1, and the queue of these ticks. Queue entries that no
+    // longer match next_event are stale and skipped.
+    std::vector<time_point> next_event;
+    std::priority_queue<std::pair<time_point, node_index>, std::vector<std::pair<time_point, node_index>>, std::greater<>> events;
+
+    // Nodes visited in the current tick, and those of them that fired
+    std::vector<node_index> visited, fired;
+    std::vector<uint8_t> is_visited;
+    std::vector<float> energy_in, inhibition_in;
+
+    // Nodes that fired at each time point in the spike window at t % (track_length + 1), so a tick only clears the
+    // spikes that expire instead of a bit of every node
+    std::vector<std::vector<node_index>> fired_at;
+
+    EventBrain(Brain *_brain);
+
+    void rebuild_layout();
+    void catch_up(node_index i, time_point s);
+    void schedule(node_index i);
+    void visit(node_index i);
+    void update();
+    void set_input(const std::vector<bool> &x);
+    void store();
+    void load();
+};
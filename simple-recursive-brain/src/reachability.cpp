@@ -0,0 +1,224 @@
+#include "reachability.hpp"
+
+#include <stdexcept>
+
+using namespace std;
+
+Reachability::Reachability()
+{
+    n = 0;
+    sources = {0, -1};
+    depth = 0;
+    words = 0;
+}
+
+Reachability::Reachability(int _n, pair<node_index, node_index> _sources, int _depth)
+{
+    if (_depth < 0)
+    {
+        throw runtime_error("Reachability depth must be non-negative!");
+    }
+
+    n = _n;
+    sources = _sources;
+    depth = _depth;
+    words = (sources.second - sources.first + 64) / 64;
+
+    // Levels 0 to depth plus the unbounded level, sources reach themselves in zero steps
+    bits.assign((size_t)(depth + 2) * n * words, 0);
+    for (int k = 0; k <= depth + 1; k++)
+    {
+        for (node_index s = sources.first; s <= sources.second; s++)
+        {
+            const int b = s - sources.first;
+            row(k, s)[b >> 6] |= 1ULL << (b & 63);
+        }
+    }
+}
+
+// Level index for a query, where a max_depth of 0 means any number of steps
+int Reachability::level_index(int max_depth) const
+{
+    if (max_depth > depth)
+    {
+        throw runtime_error("Reachability query deeper than the tracked depth!");
+    }
+    return max_depth == 0 ? depth + 1 : max_depth;
+}
+
+uint64_t *Reachability::row(int level, node_index j)
+{
+    return bits.data() + ((size_t)level * n + j) * words;
+}
+
+const uint64_t *Reachability::row(int level, node_index j) const
+{
+    return bits.data() + ((size_t)level * n + j) * words;
+}
+
+// Flood all sources through the whole graph, one level per step
+void Reachability::build(const vector<map<node_index, Edge>> &edges)
+{
+    *this = Reachability(n, sources, depth);
+
+    for (int k = 1; k <= depth; k++)
+    {
+        copy(row(k - 1, 0), row(k, 0), row(k, 0));
+        for (node_index i = 0; i < n; i++)
+        {
+            const uint64_t *from = row(k - 1, i);
+            for (auto x : edges[i])
+            {
+                uint64_t *to = row(k, x.first);
+                for (int w = 0; w < words; w++)
+                {
+                    to[w] |= from[w];
+                }
+            }
+        }
+    }
+
+    // Continue from the deepest bounded level until nothing changes
+    const int unbounded = depth + 1;
+    copy(row(depth, 0), row(unbounded, 0), row(unbounded, 0));
+    vector<pair<int, node_index>> stack;
+    vector<uint64_t> stack_bits;
+    for (node_index i = 0; i < n; i++)
+    {
+        for (auto x : edges[i])
+        {
+            stack.push_back({unbounded, x.first});
+            stack_bits.insert(stack_bits.end(), row(unbounded, i), row(unbounded, i) + words);
+        }
+    }
+    propagate(edges, stack, stack_bits);
+}
+
+// Update the levels after edge i -> j was added to edges
+void Reachability::add_edge(const vector<map<node_index, Edge>> &edges, node_index i, node_index j)
+{
+    // Nothing is tracked until the reachability is set up for a graph
+    if (n == 0)
+    {
+        return;
+    }
+
+    vector<pair<int, node_index>> stack;
+    vector<uint64_t> stack_bits;
+    for (int k = 1; k <= depth + 1; k++)
+    {
+        // Sources reaching i in k - 1 steps reach j in k steps, and the unbounded level feeds itself
+        const int from = k <= depth ? k - 1 : k;
+        stack.push_back({k, j});
+        stack_bits.insert(stack_bits.end(), row(from, i), row(from, i) + words);
+    }
+    propagate(edges, stack, stack_bits);
+}
+
+// Add each stacked set of sources to its node at its level and every level above, then push whatever was new
+// on to the node's children one level up. Every bit is set at most once per node and level, so this terminates.
+void Reachability::propagate(const vector<map<node_index, Edge>> &edges, vector<pair<int, node_index>> &stack, vector<uint64_t> &stack_bits)
+{
+    const int unbounded = depth + 1;
+    vector<uint64_t> add(words);
+    while (!stack.empty())
+    {
+        const auto [k, j] = stack.back();
+        stack.pop_back();
+
+        uint64_t *own = row(k, j);
+        const uint64_t *in = stack_bits.data() + stack_bits.size() - words;
+        bool any = false;
+        for (int w = 0; w < words; w++)
+        {
+            add[w] = in[w] & ~own[w];
+            any |= add[w] != 0;
+        }
+        stack_bits.resize(stack_bits.size() - words);
+
+        if (!any)
+        {
+            continue;
+        }
+
+        for (int l = k; l <= unbounded; l++)
+        {
+            uint64_t *r = row(l, j);
+            for (int w = 0; w < words; w++)
+            {
+                r[w] |= add[w];
+            }
+        }
+
+        const int next = k < depth ? k + 1 : unbounded;
+        for (auto x : edges[j])
+        {
+            stack.push_back({next, x.first});
+            stack_bits.insert(stack_bits.end(), add.begin(), add.end());
+        }
+    }
+}
+
+// True if any source reaches node j in at most max_depth steps
+bool Reachability::reached(node_index j, int max_depth) const
+{
+    const uint64_t *r = row(level_index(max_depth), j);
+    for (int w = 0; w < words; w++)
+    {
+        if (r[w])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// True if the source reaches any node in range in at most max_depth steps
+bool Reachability::reaches_any(node_index source, pair<node_index, node_index> range, int max_depth) const
+{
+    const int level = level_index(max_depth);
+    const int b = source - sources.first;
+    for (node_index j = range.first; j <= range.second; j++)
+    {
+        if ((row(level, j)[b >> 6] >> (b & 63)) & 1)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Return sources that reach no node in range, plus nodes in range that no source reaches, in at most max_depth steps
+set<node_index> Reachability::disconnected(pair<node_index, node_index> range, int max_depth) const
+{
+    const int level = level_index(max_depth);
+    set<node_index> res;
+
+    vector<uint64_t> any(words, 0);
+    for (node_index j = range.first; j <= range.second; j++)
+    {
+        const uint64_t *r = row(level, j);
+        bool is_reached = false;
+        for (int w = 0; w < words; w++)
+        {
+            any[w] |= r[w];
+            is_reached |= r[w] != 0;
+        }
+
+        if (!is_reached)
+        {
+            res.insert(j);
+        }
+    }
+
+    for (node_index s = sources.first; s <= sources.second; s++)
+    {
+        const int b = s - sources.first;
+        if (!((any[b >> 6] >> (b & 63)) & 1))
+        {
+            res.insert(s);
+        }
+    }
+
+    return res;
+}
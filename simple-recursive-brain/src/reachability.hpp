@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "edge.hpp"
+#include "util.hpp"
+
+// Reachability from a range of source nodes with one bit per source, so all sources are flooded at once.
+// Level k holds for every node the sources that reach it in at most k steps, for k up to depth, and one more
+// level holds the sources that reach it in any number of steps. As edges are only ever added, a new edge just
+// pushes the bits its source is missing forward, so the levels stay exact while the graph grows.
+struct Reachability
+{
+    int n;
+    std::pair<node_index, node_index> sources;
+    int depth;
+    int words;
+    std::vector<uint64_t> bits;
+
+    Reachability();
+    Reachability(int _n, std::pair<node_index, node_index> _sources, int _depth);
+
+    void build(const std::vector<std::map<node_index, Edge>> &edges);
+    void add_edge(const std::vector<std::map<node_index, Edge>> &edges, node_index i, node_index j);
+    bool reached(node_index j, int max_depth = 0) const;
+    bool reaches_any(node_index source, std::pair<node_index, node_index> range, int max_depth = 0) const;
+    std::set<node_index> disconnected(std::pair<node_index, node_index> range, int max_depth = 0) const;
+    int level_index(int max_depth) const;
+    uint64_t *row(int level, node_index j);
+    const uint64_t *row(int level, node_index j) const;
+    void propagate(const std::vector<std::map<node_index, Edge>> &edges, std::vector<std::pair<int, node_index>> &stack, std::vector<uint64_t> &stack_bits);
+};
@@ -0,0 +1,144 @@
+#include "result_writer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+ResultWriter::ResultWriter(ostream *_shared, bool _binary, size_t _block_size)
+{
+    binary = _binary;
+    block_size = _block_size;
+    shared = _shared;
+    buf.reserve(block_size + 64);
+}
+
+ResultWriter::ResultWriter(const string &file, bool _binary, size_t _block_size) : own(file, _binary ? ios::binary : ios::out)
+{
+    if (!own)
+    {
+        throw runtime_error("Failed to open result file " + file);
+    }
+
+    binary = _binary;
+    block_size = _block_size;
+    shared = 0;
+    buf.reserve(block_size + 64);
+}
+
+ResultWriter::~ResultWriter()
+{
+    flush();
+}
+
+void ResultWriter::write_header()
+{
+    if (!binary)
+    {
+        buf += "thread_id, test_id, iteration, test, rolling_rate\n";
+    }
+}
+
+void ResultWriter::add(const ResultRow &x)
+{
+    if (binary)
+    {
+        buf.append((const char *)&x.thread_id, 4);
+        buf.append((const char *)&x.test_id, 4);
+        buf.append((const char *)&x.iteration, 4);
+        buf.append((const char *)&x.r, 4);
+        buf.append((const char *)&x.hit_rate, 4);
+    }
+    else
+    {
+        // Same formatting as streaming the values to cout
+        char line[128];
+#ifdef NODEBUG
+        const char *prefix = "";
+#else
+        const char *prefix = "Row: ";
+#endif
+        const int len = snprintf(line, sizeof(line), "%s%d, %d, %d, %g, %g\n", prefix, x.thread_id, x.test_id, x.iteration, x.r, x.hit_rate);
+        buf.append(line, len);
+    }
+
+    if (buf.size() >= block_size)
+    {
+        flush();
+    }
+}
+
+void ResultWriter::flush()
+{
+    if (buf.empty())
+    {
+        return;
+    }
+
+    if (shared)
+    {
+#pragma omp critical(result_writer)
+        {
+            shared->write(buf.data(), buf.size());
+            shared->flush();
+        }
+    }
+    else
+    {
+        own.write(buf.data(), buf.size());
+        own.flush();
+    }
+    buf.clear();
+}
+
+void HitRateStats::grow(int size)
+{
+    if (size > count.size())
+    {
+        count.resize(size, 0);
+        sum.resize(size, 0);
+        min.resize(size, numeric_limits<double>::infinity());
+        max.resize(size, -numeric_limits<double>::infinity());
+    }
+}
+
+void HitRateStats::add(int iteration, float hit_rate)
+{
+    grow(iteration + 1);
+    count[iteration]++;
+    sum[iteration] += hit_rate;
+    min[iteration] = std::min(min[iteration], (double)hit_rate);
+    max[iteration] = std::max(max[iteration], (double)hit_rate);
+}
+
+void HitRateStats::merge(const HitRateStats &x)
+{
+    grow(x.count.size());
+    for (int i = 0; i < x.count.size(); i++)
+    {
+        if (!x.count[i])
+        {
+            continue;
+        }
+
+        count[i] += x.count[i];
+        sum[i] += x.sum[i];
+        min[i] = std::min(min[i], x.min[i]);
+        max[i] = std::max(max[i], x.max[i]);
+    }
+}
+
+void HitRateStats::write_csv(ostream &out) const
+{
+    out << "iteration, tests, mean_rate, min_rate, max_rate" << endl;
+    for (int i = 0; i < count.size(); i++)
+    {
+        if (count[i])
+        {
+            out << i << ", " << count[i] << ", " << sum[i] / count[i] << ", " << min[i] << ", " << max[i] << "\n";
+        }
+    }
+    out.flush();
+}
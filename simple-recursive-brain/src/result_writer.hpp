@@ -0,0 +1,48 @@
+#pragma once
+
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// One row of test output, written once per tunnel step
+struct ResultRow
+{
+    int thread_id;
+    int test_id;
+    int iteration;
+    float r;
+    float hit_rate;
+};
+
+// Buffers the rows of one thread and writes them in blocks, either to a file owned by the thread or to a stream
+// shared by all threads. Writes to a shared stream take a lock once per block instead of once per row.
+// Binary rows are the ResultRow fields packed in order as native 32 bit values, 20 bytes per row.
+struct ResultWriter
+{
+    bool binary;
+    size_t block_size;
+    std::ostream *shared;
+    std::ofstream own;
+    std::string buf;
+
+    ResultWriter(std::ostream *_shared, bool _binary, size_t _block_size);
+    ResultWriter(const std::string &file, bool _binary, size_t _block_size);
+    ~ResultWriter();
+
+    void write_header();
+    void add(const ResultRow &x);
+    void flush();
+};
+
+// Hit rate per iteration summarized over tests, kept per thread and merged when the run ends
+struct HitRateStats
+{
+    std::vector<long> count;
+    std::vector<double> sum, min, max;
+
+    void grow(int size);
+    void add(int iteration, float hit_rate);
+    void merge(const HitRateStats &x);
+    void write_csv(std::ostream &out) const;
+};
@@ -0,0 +1,127 @@
+#include "snapshot.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+using namespace std;
+
+const uint32_t checkpoint_magic = 0x43425253; // "SRBC"
+
+// Record layout: magic, test id, iteration, hit rate, brain snapshot size, extra size, snapshot, extra
+struct CheckpointHeader
+{
+    uint32_t magic;
+    int32_t test_id;
+    int32_t iteration;
+    float hit_rate;
+    uint64_t brain_size;
+    uint64_t extra_size;
+};
+
+CheckpointWriter::CheckpointWriter(const string &file)
+{
+    fd = open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0)
+    {
+        throw runtime_error("Failed to open checkpoint file " + file + ": " + strerror(errno));
+    }
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    close(fd);
+}
+
+void CheckpointWriter::add(const Brain &b, int test_id, int iteration, float hit_rate, const string &extra)
+{
+    const string brain = b.snapshot();
+    ByteWriter w;
+    w.put(CheckpointHeader{checkpoint_magic, test_id, iteration, hit_rate, brain.size(), extra.size()});
+    w.buf += brain;
+    w.buf += extra;
+
+    bool ok = true;
+#pragma omp critical(checkpoint_writer)
+    {
+        const char *p = w.buf.data();
+        size_t left = w.buf.size();
+        while (left > 0)
+        {
+            const ssize_t res = write(fd, p, left);
+            if (res < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (res <= 0)
+            {
+                ok = false;
+                break;
+            }
+            p += res;
+            left -= res;
+        }
+    }
+
+    if (!ok)
+    {
+        throw runtime_error(string("Failed to write checkpoint: ") + strerror(errno));
+    }
+}
+
+Checkpoint::Checkpoint(const string &file)
+{
+    data = 0;
+    size = 0;
+
+    const int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw runtime_error("Failed to open checkpoint file " + file + ": " + strerror(errno));
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+    size = st.st_size;
+    if (size > 0)
+    {
+        data = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        data = 0;
+        throw runtime_error("Failed to map checkpoint file " + file);
+    }
+
+    // Stop at the first record that is not complete, which is where a killed run stopped writing
+    ByteReader r((const char *)data, size);
+    while (r.end - r.p >= sizeof(CheckpointHeader))
+    {
+        const CheckpointHeader h = r.get<CheckpointHeader>();
+        if (h.magic != checkpoint_magic || r.end - r.p < h.brain_size || r.end - r.p - h.brain_size < h.extra_size)
+        {
+            break;
+        }
+
+        entries.push_back({h.test_id, h.iteration, h.hit_rate, r.p, h.brain_size, string(r.p + h.brain_size, h.extra_size)});
+        r.p += h.brain_size + h.extra_size;
+    }
+}
+
+Checkpoint::~Checkpoint()
+{
+    if (data)
+    {
+        munmap(data, size);
+    }
+}
+
+Brain Checkpoint::load(int k) const
+{
+    return Brain(entries.at(k).brain, entries.at(k).brain_size);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "brain.hpp"
+
+// Appends plain values in native layout
+struct ByteWriter
+{
+    std::string buf;
+
+    template <typename T>
+    void put(const T &x)
+    {
+        buf.append((const char *)&x, sizeof(T));
+    }
+
+    template <typename T>
+    void put_array(const T *x, size_t count)
+    {
+        buf.append((const char *)x, count * sizeof(T));
+    }
+};
+
+// Reads plain values written by ByteWriter, throwing if the data ends early
+struct ByteReader
+{
+    const char *p;
+    const char *end;
+
+    ByteReader(const char *data, size_t size) : p(data), end(data + size) {}
+
+    void need(size_t bytes) const
+    {
+        if (end - p < bytes)
+        {
+            throw std::runtime_error("Snapshot data ended unexpectedly!");
+        }
+    }
+
+    template <typename T>
+    T get()
+    {
+        T x;
+        need(sizeof(T));
+        memcpy(&x, p, sizeof(T));
+        p += sizeof(T);
+        return x;
+    }
+
+    template <typename T>
+    void get_array(T *x, size_t count)
+    {
+        need(count * sizeof(T));
+        memcpy(x, p, count * sizeof(T));
+        p += count * sizeof(T);
+    }
+};
+
+// What a checkpoint knows about each saved brain besides the brain itself. Extra is free for the program that
+// writes the checkpoint, test-run uses it for the random engine and game state of the test.
+struct CheckpointEntry
+{
+    int test_id;
+    int iteration;
+    float hit_rate;
+    const char *brain;
+    size_t brain_size;
+    std::string extra;
+};
+
+// Append-only checkpoint file of brain snapshots. Records from different threads are written whole under a lock, and a
+// record cut short by a killed run is ignored when the file is read back.
+struct CheckpointWriter
+{
+    int fd;
+
+    CheckpointWriter(const std::string &file);
+    ~CheckpointWriter();
+    CheckpointWriter(const CheckpointWriter &) = delete;
+    CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+    void add(const Brain &b, int test_id, int iteration, float hit_rate, const std::string &extra = "");
+};
+
+// Read only memory map of a checkpoint file, brains are restored straight from the mapped snapshots
+struct Checkpoint
+{
+    void *data;
+    size_t size;
+    std::vector<CheckpointEntry> entries;
+
+    Checkpoint(const std::string &file);
+    ~Checkpoint();
+    Checkpoint(const Checkpoint &) = delete;
+    Checkpoint &operator=(const Checkpoint &) = delete;
+
+    Brain load(int k) const;
+};
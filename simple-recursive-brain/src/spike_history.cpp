@@ -0,0 +1,113 @@
+#include "spike_history.hpp"
+
+#include <stdexcept>
+
+using namespace std;
+
+SpikeHistory::SpikeHistory(int _n, int _track_length)
+{
+    if (_track_length < 0)
+    {
+        throw runtime_error("Track length must be non-negative!");
+    }
+
+    n = _n;
+    track_length = _track_length;
+    t = 0;
+
+    // Capacity is a power of two so negative times map to valid slots as well
+    capacity = 64;
+    while (capacity < track_length + 1)
+    {
+        capacity *= 2;
+    }
+    words = capacity / 64;
+    bits.assign((size_t)n * words, 0);
+}
+
+// Move the window to end at _t, which must be the previous time plus one, dropping the expired time point
+void SpikeHistory::advance(time_point _t)
+{
+    t = _t;
+    const int slot = (t - track_length - 1) & (capacity - 1);
+    const uint64_t keep = ~(1ULL << (slot & 63));
+    for (size_t k = slot >> 6; k < bits.size(); k += words)
+    {
+        bits[k] &= keep;
+    }
+}
+
+// Like advance, but only clears the expired time point of the given nodes, which must include all nodes that fired then
+void SpikeHistory::advance(time_point _t, const vector<node_index> &expired)
+{
+    t = _t;
+    const int slot = (t - track_length - 1) & (capacity - 1);
+    const uint64_t keep = ~(1ULL << (slot & 63));
+    for (node_index i : expired)
+    {
+        bits[(size_t)i * words + (slot >> 6)] &= keep;
+    }
+}
+
+void SpikeHistory::set_fired(node_index i)
+{
+    const int slot = t & (capacity - 1);
+    bits[(size_t)i * words + (slot >> 6)] |= 1ULL << (slot & 63);
+}
+
+bool SpikeHistory::did_fire_at(node_index i, time_point s) const
+{
+    if (s > t || s < t - track_length)
+    {
+        return false;
+    }
+
+    const int slot = s & (capacity - 1);
+    return (bits[(size_t)i * words + (slot >> 6)] >> (slot & 63)) & 1;
+}
+
+// Find the latest firing time that is no later than s, or -1 if there is none in the window
+time_point SpikeHistory::last_fired_before(node_index i, time_point s) const
+{
+    const uint64_t *row = bits.data() + (size_t)i * words;
+    const time_point lo = t - track_length;
+    if (s > t)
+    {
+        s = t;
+    }
+
+    while (s >= lo)
+    {
+        // Bits at or below this slot's bit in the word correspond to times s, s - 1, ...
+        const int slot = s & (capacity - 1);
+        const int bit = slot & 63;
+        uint64_t m = row[slot >> 6];
+        if (bit < 63)
+        {
+            m &= (1ULL << (bit + 1)) - 1;
+        }
+        if (s - lo < bit)
+        {
+            m &= ~((1ULL << (bit - (s - lo))) - 1);
+        }
+
+        if (m)
+        {
+            return s - (bit - (63 - __builtin_clzll(m)));
+        }
+        s -= bit + 1;
+    }
+
+    return -1;
+}
+
+int SpikeHistory::count(node_index i) const
+{
+    const uint64_t *row = bits.data() + (size_t)i * words;
+    int res = 0;
+    for (int k = 0; k < words; k++)
+    {
+        res += __builtin_popcountll(row[k]);
+    }
+    return res;
+}
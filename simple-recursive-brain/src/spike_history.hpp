@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "util.hpp"
+
+// Firing times of all nodes in the last track_length + 1 time points, stored as one ring bitset per node
+// in a single allocation. Time t maps to bit t % capacity, and bits are cleared as they fall out of the
+// window, so a row only ever holds firing times in [t - track_length, t].
+struct SpikeHistory
+{
+    int n;
+    int track_length;
+    int words;
+    int capacity;
+    time_point t;
+    std::vector<uint64_t> bits;
+
+    SpikeHistory(int _n, int _track_length);
+
+    void advance(time_point _t);
+    void advance(time_point _t, const std::vector<node_index> &expired);
+    void set_fired(node_index i);
+    bool did_fire_at(node_index i, time_point s) const;
+    time_point last_fired_before(node_index i, time_point s) const;
+    int count(node_index i) const;
+
+    // Call f with each firing time of node i in [from, to] in increasing order, the range is clipped to the window
+    template <typename F>
+    void for_each_fired(node_index i, time_point from, time_point to, F f) const
+    {
+        const uint64_t *row = bits.data() + (size_t)i * words;
+        time_point s = std::max(from, t - track_length);
+        to = std::min(to, t);
+        while (s <= to)
+        {
+            const int slot = s & (capacity - 1);
+            const int bit = slot & 63;
+            const int span = std::min(64 - bit, to - s + 1);
+            uint64_t m = row[slot >> 6] >> bit;
+            if (span < 64)
+            {
+                m &= (1ULL << span) - 1;
+            }
+
+            while (m)
+            {
+                f(s + __builtin_ctzll(m));
+                m &= m - 1;
+            }
+            s += span;
+        }
+    }
+};
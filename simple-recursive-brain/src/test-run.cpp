@@ -4,9 +4,17 @@
 #include <set>
 #include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <sstream>
 #include <omp.h>
 
 #include "brain.hpp"
+#include "brain_batch.hpp"
+#include "result_writer.hpp"
+#include "snapshot.hpp"
 #include "util.hpp"
 
 using namespace std;
@@ -106,6 +114,37 @@ struct GameState
 const int GameState::viewport;
 const int GameState::height;
 
+// The part of a test that lives outside the brain, stored with checkpoints so a resumed test continues exactly
+string save_test_state(const GameState &state)
+{
+    stringstream engine;
+    engine << get_engine();
+    const string e = engine.str();
+
+    ByteWriter w;
+    w.put<int32_t>(e.size());
+    w.put_array(e.data(), e.size());
+    w.put_array(state.ceiling.data(), state.viewport);
+    w.put_array(state.floor.data(), state.viewport);
+    w.put_array(state.food.data(), state.viewport);
+    w.put<int32_t>(state.pos);
+    return w.buf;
+}
+
+void load_test_state(const string &x, GameState &state)
+{
+    ByteReader r(x.data(), x.size());
+    string e(r.get<int32_t>(), 0);
+    r.get_array(e.data(), e.size());
+    stringstream engine(e);
+    engine >> get_engine();
+
+    r.get_array(state.ceiling.data(), state.viewport);
+    r.get_array(state.floor.data(), state.viewport);
+    r.get_array(state.food.data(), state.viewport);
+    state.pos = r.get<int32_t>();
+}
+
 tunnel_choice get_tunnel_choice(bool in1, bool in2)
 {
     if (in1 && in2)
@@ -126,10 +165,9 @@ tunnel_choice get_tunnel_choice(bool in1, bool in2)
     }
 }
 
-// d_in = 30, d_out = 2
-float test_tunnel(Brain &b, GameState &state)
+// Encode the visible tunnel, the food and the bot position as input, d_in = 55
+vector<bool> tunnel_input(const GameState &state)
 {
-
     // Add floor and ceiling to input
     vector<bool> input((2 * state.viewport + 1) * state.height, false);
     for (int col = 0; col < state.viewport; col++)
@@ -154,6 +192,29 @@ float test_tunnel(Brain &b, GameState &state)
 
     // Add self to input
     input[2 * state.viewport * state.height + state.pos] = true;
+    return input;
+}
+
+// Choose from the output counts over the thinking steps, move through the tunnel and return the feedback
+float tunnel_step(GameState &state, const vector<float> &output)
+{
+    tunnel_choice choice = get_tunnel_choice(output[0] > 3, output[1] > 3);
+
+    // Update tunnel state
+    bool collided = state.shift();
+    float feedback = state.apply_choice(choice);
+    if (collided)
+    {
+        feedback = -1;
+    }
+
+    return feedback;
+}
+
+// d_in = 55, d_out = 2
+float test_tunnel(Brain &b, GameState &state)
+{
+    const vector<bool> input = tunnel_input(state);
 
     // Run network
     vector<float> output(2);
@@ -177,17 +238,54 @@ float test_tunnel(Brain &b, GameState &state)
     cout << endl;
 #endif
 
-    tunnel_choice choice = get_tunnel_choice(output[0] > 3, output[1] > 3);
+    return tunnel_step(state, output);
+}
 
-    // Update tunnel state
-    bool collided = state.shift();
-    float feedback = state.apply_choice(choice);
-    if (collided)
+// One test of a brain in the tunnel, with its own random engine when tests share a thread in a batch
+struct TunnelTest
+{
+    int test_id;
+    int first_iteration;
+    float hit_rate;
+    GameState state;
+    unique_ptr<Brain> brain;
+    default_random_engine engine;
+};
+
+// Run test_tunnel for every test in the batch with the brains stepping in lockstep
+vector<float> test_tunnel_batch(BrainBatch &batch, vector<TunnelTest> &tests)
+{
+    vector<vector<bool>> inputs;
+    for (auto &x : tests)
     {
-        feedback = -1;
+        inputs.push_back(tunnel_input(x.state));
     }
 
-    return feedback;
+    vector<vector<float>> output(tests.size(), vector<float>(2));
+    for (int i = 0; i < 10; i++)
+    {
+        for (int k = 0; k < tests.size(); k++)
+        {
+            batch.set_input(k, inputs[k]);
+        }
+
+        batch.update();
+        for (int k = 0; k < tests.size(); k++)
+        {
+            vector<bool> buf = tests[k].brain->get_output();
+            output[k][0] += buf[0];
+            output[k][1] += buf[1];
+        }
+    }
+
+    vector<float> res;
+    for (int k = 0; k < tests.size(); k++)
+    {
+        swap(get_engine(), tests[k].engine);
+        res.push_back(tunnel_step(tests[k].state, output[k]));
+        swap(get_engine(), tests[k].engine);
+    }
+    return res;
 }
 
 /* TODO
@@ -197,58 +295,263 @@ We also need a way to modify energy uptake in feedback
 May also look into a method for crossing / GA
 */
 
-// Usage: SRB n epochs threads
+// Usage: SRB n epochs [threads] [options]
+// Options:
+//   tests k          stop after k tests, default is to run until killed
+//   seed s           seed test i with s + i, so every test is reproducible regardless of thread
+//   out file         write rows to file instead of stdout
+//   split            with out, each thread writes its own file.<thread_id>
+//   binary           write rows as packed binary ResultRow records instead of csv
+//   norows           do not write rows at all
+//   aggregate file   write per iteration hit rate mean, min and max over all tests to file when the run ends
+//   checkpoint file  append each brain to the checkpoint file when its test ends
+//   every k          with checkpoint, also append each brain every k iterations
+//   resume file      continue the latest brain of every test in the checkpoint file up to epochs iterations
+//   best k           with resume, only continue the k brains with the highest hit rate
+//   fork m           with resume, run m variants of each brain. Variant 0 continues exactly, the others draw new
+//                    random numbers. Variant v of test x gets test id x * m + v.
+//   batch k          step k tests per thread in lockstep with a BrainBatch, with the same results per test
 int main(int argc, char **argv)
 {
     int d_in = GameState::get_input_dim(); // 55
     int d_out = 2, con_depth = 4;
     int n = atoi(argv[1]), epochs = atoi(argv[2]);
-    int n_threads = argc == 4 ? atoi(argv[3]) : 6;
+    int n_threads = argc >= 4 ? atoi(argv[3]) : 6;
     int test_id_seed = 0;
+    int max_tests = 0;
+    bool use_seed = false, split = false, binary = false, rows = true;
+    unsigned int seed = 0;
+    string outfile, aggregate_file, checkpoint_file, resume_file;
+    int checkpoint_every = 0, best = 0, variants = 1, batch_size = 1;
+    const size_t block_size = 1 << 16;
     omp_set_num_threads(n_threads);
 
+    for (int i = 4; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "tests"))
+        {
+            max_tests = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "seed"))
+        {
+            use_seed = true;
+            seed = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "out"))
+        {
+            outfile = argv[++i];
+        }
+        else if (!strcmp(argv[i], "split"))
+        {
+            split = true;
+        }
+        else if (!strcmp(argv[i], "binary"))
+        {
+            binary = true;
+        }
+        else if (!strcmp(argv[i], "norows"))
+        {
+            rows = false;
+        }
+        else if (!strcmp(argv[i], "aggregate"))
+        {
+            aggregate_file = argv[++i];
+        }
+        else if (!strcmp(argv[i], "checkpoint"))
+        {
+            checkpoint_file = argv[++i];
+        }
+        else if (!strcmp(argv[i], "every"))
+        {
+            checkpoint_every = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "resume"))
+        {
+            resume_file = argv[++i];
+        }
+        else if (!strcmp(argv[i], "best"))
+        {
+            best = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "fork"))
+        {
+            variants = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "batch"))
+        {
+            batch_size = max(atoi(argv[++i]), 1);
+        }
+        else
+        {
+            cout << "Unknown option " << argv[i] << endl;
+            exit(-1);
+        }
+    }
+
     if (n < 60)
     {
         cout << "This version requires at least 60 nodes!" << endl;
         exit(-1);
     }
 
+    // Resumed tests are the latest record of each test in the checkpoint, optionally only the best ones
+    unique_ptr<Checkpoint> resume;
+    vector<int> resume_entries;
+    if (resume_file.length())
+    {
+        resume = make_unique<Checkpoint>(resume_file);
+        map<int, int> latest;
+        for (int k = 0; k < resume->entries.size(); k++)
+        {
+            const CheckpointEntry &e = resume->entries[k];
+            if (!latest.contains(e.test_id) || resume->entries[latest[e.test_id]].iteration <= e.iteration)
+            {
+                latest[e.test_id] = k;
+            }
+        }
+
+        for (auto x : latest)
+        {
+            resume_entries.push_back(x.second);
+        }
+
+        if (best > 0 && best < resume_entries.size())
+        {
+            stable_sort(resume_entries.begin(), resume_entries.end(), [&](int a, int b)
+                        { return resume->entries[a].hit_rate > resume->entries[b].hit_rate; });
+            resume_entries.resize(best);
+        }
+
+        const int resume_tests = resume_entries.size() * max(variants, 1);
+        max_tests = max_tests ? min(max_tests, resume_tests) : resume_tests;
+        if (max_tests == 0)
+        {
+            cout << "No brains to resume in " << resume_file << endl;
+            exit(-1);
+        }
+    }
+
+    unique_ptr<CheckpointWriter> checkpoint;
+    if (checkpoint_file.length())
+    {
+        checkpoint = make_unique<CheckpointWriter>(checkpoint_file);
+    }
+
+    if (aggregate_file.length() && max_tests == 0)
+    {
+        cout << "aggregate requires a fixed number of tests!" << endl;
+        exit(-1);
+    }
+
 #ifndef NODEBUG
     cout << "Starting!" << endl;
 #endif
 
+    // Threads share this stream unless they write their own files
+    ofstream merged;
+    ostream *shared = &cout;
+    if (outfile.length() && !split)
+    {
+        merged.open(outfile, binary ? ios::binary : ios::out);
+        if (!merged)
+        {
+            cout << "Failed to open " << outfile << endl;
+            exit(-1);
+        }
+        shared = &merged;
+    }
+
 #ifdef NODEBUG
-    cout << "thread_id, test_id, iteration, test, rolling_rate" << endl;
+    if (rows && !binary && !split)
+    {
+        ResultWriter(shared, false, 0).write_header();
+    }
 #endif
 
+    HitRateStats stats;
+
 #pragma omp parallel
-    while (true)
     {
-        int test_id;
-#pragma omp critical
+        const int thread_id = omp_get_thread_num();
+        unique_ptr<ResultWriter> writer;
+        if (split)
+        {
+            writer = make_unique<ResultWriter>(outfile + "." + to_string(thread_id), binary, block_size);
+#ifdef NODEBUG
+            writer->write_header();
+#endif
+        }
+        else
         {
-            test_id = test_id_seed++;
+            writer = make_unique<ResultWriter>(shared, binary, block_size);
         }
+        HitRateStats local_stats;
+
+        // Set up a fresh or resumed test, leaving the thread's engine in the state the test continues from
+        auto start_test = [&](int task, TunnelTest &x)
+        {
+            x.test_id = task;
+            x.first_iteration = 1;
+            x.hit_rate = 0.125;
 
-        Brain b(n, 3, d_in, d_out, 40); // n, connectivity, d_in, d_out, track_l
-        b.initialize(con_depth);
-        float hit_rate = 0.125;
-        int row = 1, col = 1;
-        GameState state;
+            if (resume)
+            {
+                const int variant = task % variants;
+                const CheckpointEntry &e = resume->entries[resume_entries[task / variants]];
+                x.test_id = variants > 1 ? e.test_id * variants + variant : e.test_id;
+                x.brain = make_unique<Brain>(resume->load(resume_entries[task / variants]));
+                x.first_iteration = e.iteration + 1;
+                x.hit_rate = e.hit_rate;
+
+                load_test_state(e.extra, x.state);
+                if (variant > 0 && use_seed)
+                {
+                    seed_engine(seed + x.test_id);
+                }
+                else if (variant > 0)
+                {
+                    seed_engine(random_device{}());
+                }
+            }
+            else
+            {
+                if (use_seed)
+                {
+                    seed_engine(seed + x.test_id);
+                }
+                else if (batch_size > 1)
+                {
+                    // Tests in a batch take turns with the thread's engine, so they need their own streams
+                    seed_engine(random_device{}());
+                }
+
+                x.brain = make_unique<Brain>(n, 3, d_in, d_out, 40); // n, connectivity, d_in, d_out, track_l
+                x.brain->initialize(con_depth);
+            }
+        };
 
-        for (int i = 1; i < epochs; i++)
+        auto checkpoint_due = [&](int i)
         {
-            const float r = test_tunnel(b, state);
-            b.feedback(r);
+            return checkpoint && (i == epochs - 1 || (checkpoint_every > 0 && i % checkpoint_every == 0));
+        };
 
-            hit_rate = 0.999 * hit_rate + 0.001 * r;
-#pragma omp critical
+        // Give feedback and record the result of iteration i, with the test's engine in place
+        auto finish_iteration = [&](TunnelTest &x, int i, float r)
+        {
+            x.brain->feedback(r);
+
+            x.hit_rate = 0.999 * x.hit_rate + 0.001 * r;
+            if (rows)
             {
-#ifdef NODEBUG
-                cout << omp_get_thread_num() << ", " << test_id << ", " << i << ", " << r << ", " << hit_rate << endl;
-#else
-                cout << "Row: " << omp_get_thread_num() << ", " << test_id << ", " << i << ", " << r << ", " << hit_rate << endl;
-#endif
+                writer->add({thread_id, x.test_id, i, r, x.hit_rate});
+            }
+            if (aggregate_file.length())
+            {
+                local_stats.add(i, x.hit_rate);
+            }
+            if (checkpoint_due(i))
+            {
+                checkpoint->add(*x.brain, x.test_id, i, x.hit_rate, save_test_state(x.state));
             }
 
             // // Sigmoid start at 0.143, hit ~0.255 at 1000, 0.356 at 2000, 0.63 at 10000
@@ -259,8 +562,88 @@ int main(int argc, char **argv)
             //     // Not performing well enough, start over
             //     break;
             // }
+        };
+
+        while (true)
+        {
+            vector<TunnelTest> tests;
+            for (int k = 0; k < batch_size; k++)
+            {
+                int task;
+#pragma omp atomic capture
+                task = test_id_seed++;
+
+                if (max_tests && task >= max_tests)
+                {
+                    break;
+                }
+
+                tests.emplace_back();
+                start_test(task, tests.back());
+                tests.back().engine = get_engine();
+            }
+
+            if (tests.empty())
+            {
+                break;
+            }
+
+            if (batch_size == 1)
+            {
+                TunnelTest &x = tests[0];
+                for (int i = x.first_iteration; i < epochs; i++)
+                {
+                    finish_iteration(x, i, test_tunnel(*x.brain, x.state));
+                }
+            }
+            else
+            {
+                // Resumed tests may start at different iterations, a test that is done idles until the batch is
+                vector<Brain *> brains;
+                int steps = 0;
+                for (auto &x : tests)
+                {
+                    brains.push_back(x.brain.get());
+                    steps = max(steps, epochs - x.first_iteration);
+                }
+                BrainBatch batch(brains);
+
+                for (int step = 0; step < steps; step++)
+                {
+                    const vector<float> r = test_tunnel_batch(batch, tests);
+                    bool stored = false;
+                    for (int k = 0; k < tests.size(); k++)
+                    {
+                        const int i = tests[k].first_iteration + step;
+                        if (i < epochs)
+                        {
+                            // Energy only goes back to the brains when a checkpoint needs it
+                            if (checkpoint_due(i) && !stored)
+                            {
+                                batch.store();
+                                stored = true;
+                            }
+                            swap(get_engine(), tests[k].engine);
+                            finish_iteration(tests[k], i, r[k]);
+                            swap(get_engine(), tests[k].engine);
+                        }
+                    }
+                }
+            }
+
+            // Rows of finished tests are written out so nothing is lost if the run is killed between tests
+            writer->flush();
         }
+
+#pragma omp critical
+        stats.merge(local_stats);
+    }
+
+    if (aggregate_file.length())
+    {
+        ofstream f(aggregate_file);
+        stats.write_csv(f);
     }
 
     return 0;
-}
\ No newline at end of file
+}
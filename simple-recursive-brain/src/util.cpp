@@ -2,13 +2,19 @@
 
 using namespace std;
 
+// Each thread has its own engine, so brains on different threads never share or contend for random state
 default_random_engine &get_engine()
 {
-    static random_device rd; // a seed source for the random number engine
-    static default_random_engine gen(rd());
+    static thread_local default_random_engine gen(random_device{}());
     return gen;
 }
 
+// Seed the calling thread's engine
+void seed_engine(unsigned int seed)
+{
+    get_engine().seed(seed);
+}
+
 int random_int(int a, int b)
 {
     uniform_int_distribution<> distrib(a, b);
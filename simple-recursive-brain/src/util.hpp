@@ -3,6 +3,7 @@
 #include <random>
 
 std::default_random_engine &get_engine();
+void seed_engine(unsigned int seed);
 int random_int(int a, int b);
 float random_float(float a, float b);
 
@@ -1,2 +1,3 @@
-# g++ -o flann-test -I /usr/include/hdf5/serial/ -O2 flann-test.cpp -L /usr/lib/x86_64-linux-gnu/hdf5/serial/ -L /usr/lib/x86_64-linux-gnu/ -llz4 -lhdf5
-g++ -o test -I /usr/include/hdf5/serial/ -I /home/ros/code/flann/src/cpp -ggdb test.cpp -L /usr/lib/x86_64-linux-gnu/hdf5/serial/ -L /home/ros/code/flann/lib -llz4 -lhdf5 -lnlopt
+# g++ -o kdtree-test -O2 -fopenmp kdtree-test.cpp
+# g++ -o feedback-max-test -O3 -march=native -fopenmp feedback-max-test.cpp
+g++ -o test -ggdb -fopenmp test.cpp
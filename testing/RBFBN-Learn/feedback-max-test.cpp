@@ -0,0 +1,72 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "feedback_max.hpp"
+
+using namespace std;
+
+float runif() {
+  static default_random_engine gen;
+  static uniform_real_distribution<float> dist(0, 1);
+  return dist(gen);
+}
+
+double elapsed_us(chrono::high_resolution_clock::time_point t0) {
+  return chrono::duration<double, micro>(chrono::high_resolution_clock::now() - t0).count();
+}
+
+// Usage: feedback-max-test [queries]
+// Times maximize_feedback on random neighbor sets as one batch and one query at a time, and compares the maxima with
+// a grid search
+int main(int argc, char **argv) {
+  const int nq = argc > 1 ? stoi(argv[1]) : 10000;
+  const int k = 10;
+  const float bw2 = 0.1;
+
+  vector<float> o(k * nq), fb(k * nq), a(k * nq), prior(nq);
+  for (int i = 0; i < k * nq; i++) {
+    o[i] = runif();
+    fb[i] = runif();
+    a[i] = exp(-0.3 * runif() / bw2);
+  }
+  generate(prior.begin(), prior.end(), runif);
+
+  vector<float> x = prior;
+  auto t0 = chrono::high_resolution_clock::now();
+  maximize_feedback(nq, k, bw2, &o[0], &fb[0], &a[0], &x[0]);
+  cout << "Batch: " << elapsed_us(t0) / nq << " us per query" << endl;
+
+  vector<float> x1 = prior;
+  vector<float> o1(k), fb1(k), a1(k);
+  auto t1 = chrono::high_resolution_clock::now();
+  for (int j = 0; j < nq; j++) {
+    for (int i = 0; i < k; i++) {
+      o1[i] = o[i * nq + j];
+      fb1[i] = fb[i * nq + j];
+      a1[i] = a[i * nq + j];
+    }
+    maximize_feedback(1, k, bw2, &o1[0], &fb1[0], &a1[0], &x1[j]);
+  }
+  cout << "Single: " << elapsed_us(t1) / nq << " us per query" << endl;
+
+  // Grid search
+  const int ngrid = 10001;
+  vector<float> grid(nq), f(nq), df(nq), d2f(nq), scratch(6 * nq), best(nq, -1), fx(nq);
+  feedback_estimate(nq, k, bw2, &o[0], &fb[0], &a[0], &x[0], &fx[0], &df[0], &d2f[0], &scratch[0]);
+  for (int g = 0; g < ngrid; g++) {
+    fill(grid.begin(), grid.end(), g / (float)(ngrid - 1));
+    feedback_estimate(nq, k, bw2, &o[0], &fb[0], &a[0], &grid[0], &f[0], &df[0], &d2f[0], &scratch[0]);
+    for (int j = 0; j < nq; j++) best[j] = max(best[j], f[j]);
+  }
+
+  double max_gap = 0, mean_gap = 0;
+  for (int j = 0; j < nq; j++) {
+    max_gap = max(max_gap, (double)(best[j] - fx[j]));
+    mean_gap += (best[j] - fx[j]) / nq;
+  }
+  cout << "Gap to grid maximum: max " << max_gap << ", mean " << mean_gap << endl;
+
+  return 0;
+}
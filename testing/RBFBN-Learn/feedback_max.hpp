@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Maximizer of the kernel weighted feedback estimate of a node over its output x in [0, 1]
+//   f(x) = sum_i w_i(x) fb_i / sum_i w_i(x),  w_i(x) = a_i exp(-(x - o_i)² / bw2)
+// where neighbor i has output o_i, feedback fb_i and input weight a_i = exp(-input_d2_i / bw2). The maximum lies near
+// one of the neighbor outputs or at a bound, so f is evaluated at all of those and the best one is refined with a few
+// Newton steps. Queries are laid out neighbor major, neighbor i of query j at i * nq + j, so the loops over queries
+// vectorize.
+
+// exp(x) for x <= 0 with the range reduction and polynomial of the Cephes expf, so loops using it vectorize without
+// -ffast-math. Arguments below -87 give about 2^-126. There are no branches, as GCC does not if-convert float code
+// that may trap, so the clamp is max(x, -87) = (x + 87 + |x + 87|) / 2 - 87.
+inline float exp_neg(float x) {
+  x = 0.5f * (x + 87 + std::fabs(x + 87)) - 87;
+  const int32_t n = (int32_t)(x * 1.44269504f - 0.5f);
+  const float r = x - n * 0.693359375f + n * 2.12194440e-4f;
+  float p = 1.9875691500e-4f;
+  p = p * r + 1.3981999507e-3f;
+  p = p * r + 8.3334519073e-3f;
+  p = p * r + 4.1665795894e-2f;
+  p = p * r + 1.6666665459e-1f;
+  p = p * r + 5.0000001201e-1f;
+  p = p * r * r + r + 1;
+
+  // 2^n from its exponent bits
+  union {
+    int32_t bits;
+    float value;
+  } scale;
+  scale.bits = (n + 127) << 23;
+  return p * scale.value;
+}
+
+// f at x for nq queries with k neighbors each, scratch needs 2 nq floats
+inline void feedback_value(int nq, int k, float bw2, const float *o, const float *fb, const float *a, const float *x,
+                           float *f, float *scratch) {
+  float *n0 = scratch, *w0 = n0 + nq;
+  std::fill(scratch, scratch + 2 * nq, 0.f);
+  const float inv_bw2 = 1 / bw2;
+
+  for (int i = 0; i < k; i++) {
+    const float *oi = o + i * nq, *fbi = fb + i * nq, *ai = a + i * nq;
+#pragma omp simd
+    for (int j = 0; j < nq; j++) {
+      const float dx = x[j] - oi[j];
+      const float w = ai[j] * exp_neg(-dx * dx * inv_bw2);
+      w0[j] += w;
+      n0[j] += w * fbi[j];
+    }
+  }
+
+#pragma omp simd
+  for (int j = 0; j < nq; j++) f[j] = n0[j] / (w0[j] + 1e-30f);
+}
+
+// f and its first two derivatives at x for nq queries with k neighbors each, scratch needs 6 nq floats
+inline void feedback_estimate(int nq, int k, float bw2, const float *o, const float *fb, const float *a, const float *x,
+                              float *f, float *df, float *d2f, float *scratch) {
+  float *n0 = scratch, *n1 = n0 + nq, *n2 = n1 + nq, *w0 = n2 + nq, *w1 = w0 + nq, *w2 = w1 + nq;
+  std::fill(scratch, scratch + 6 * nq, 0.f);
+  const float inv_bw2 = 1 / bw2;
+
+  for (int i = 0; i < k; i++) {
+    const float *oi = o + i * nq, *fbi = fb + i * nq, *ai = a + i * nq;
+#pragma omp simd
+    for (int j = 0; j < nq; j++) {
+      // w = a exp(-(x - o)² / bw2), w' = w u, w'' = w (u² - 2 / bw2)
+      const float dx = x[j] - oi[j];
+      const float w = ai[j] * exp_neg(-dx * dx * inv_bw2);
+      const float u = -2 * dx * inv_bw2;
+      const float wu = w * u;
+      const float wuu = w * (u * u - 2 * inv_bw2);
+      w0[j] += w;
+      w1[j] += wu;
+      w2[j] += wuu;
+      n0[j] += w * fbi[j];
+      n1[j] += wu * fbi[j];
+      n2[j] += wuu * fbi[j];
+    }
+  }
+
+  // f = N / W, f' = (N' - f W') / W, f'' = (N'' - f W'' - 2 f' W') / W
+#pragma omp simd
+  for (int j = 0; j < nq; j++) {
+    const float inv_w = 1 / (w0[j] + 1e-30f);
+    f[j] = n0[j] * inv_w;
+    df[j] = (n1[j] - f[j] * w1[j]) * inv_w;
+    d2f[j] = (n2[j] - f[j] * w2[j] - 2 * df[j] * w1[j]) * inv_w;
+  }
+}
+
+// Maximize f for nq queries. x holds the prior output of each query on entry, which is kept for queries whose
+// neighbors have too little input weight to say anything, and the maximizing output on return.
+inline void maximize_feedback(int nq, int k, float bw2, const float *o, const float *fb, const float *a, float *x,
+                              int newton_steps = 3) {
+  thread_local std::vector<float> buf;
+  buf.assign(16 * nq, 0);
+  float *cand = &buf[0], *f = cand + nq, *df = f + nq, *d2f = df + nq, *scratch = d2f + nq;
+  float *best_x = scratch + 6 * nq, *best_f = best_x + nq, *best_df = best_f + nq, *best_d2f = best_df + nq;
+  float *mass = best_d2f + nq;
+  std::fill(best_f, best_f + nq, -std::numeric_limits<float>::infinity());
+
+  for (int i = 0; i < k; i++) {
+#pragma omp simd
+    for (int j = 0; j < nq; j++) mass[j] += a[i * nq + j];
+  }
+
+  // Candidates at both bounds and at the output of every neighbor
+  for (int m = -2; m < k; m++) {
+#pragma omp simd
+    for (int j = 0; j < nq; j++) cand[j] = m == -2 ? 0 : m == -1 ? 1 : std::min(std::max(o[m * nq + j], 0.f), 1.f);
+
+    feedback_value(nq, k, bw2, o, fb, a, cand, f, scratch);
+
+#pragma omp simd
+    for (int j = 0; j < nq; j++) {
+      const bool better = f[j] > best_f[j];
+      best_x[j] = better ? cand[j] : best_x[j];
+      best_f[j] = better ? f[j] : best_f[j];
+    }
+  }
+  feedback_estimate(nq, k, bw2, o, fb, a, best_x, f, best_df, best_d2f, scratch);
+
+  // Newton steps where f is concave, kept only when they improve f
+  for (int s = 0; s < newton_steps; s++) {
+#pragma omp simd
+    for (int j = 0; j < nq; j++) {
+      const bool concave = best_d2f[j] < 0;
+      const float step = -best_df[j] / (concave ? best_d2f[j] : -1.f);
+      cand[j] = concave ? best_x[j] + step : best_x[j];
+      cand[j] = std::min(std::max(cand[j], 0.f), 1.f);
+    }
+
+    feedback_estimate(nq, k, bw2, o, fb, a, cand, f, df, d2f, scratch);
+
+#pragma omp simd
+    for (int j = 0; j < nq; j++) {
+      const bool better = f[j] > best_f[j];
+      best_x[j] = better ? cand[j] : best_x[j];
+      best_f[j] = better ? f[j] : best_f[j];
+      best_df[j] = better ? df[j] : best_df[j];
+      best_d2f[j] = better ? d2f[j] : 0;
+    }
+  }
+
+#pragma omp simd
+  for (int j = 0; j < nq; j++) x[j] = mass[j] < 1e-6 ? x[j] : best_x[j];
+}
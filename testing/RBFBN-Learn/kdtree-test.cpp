@@ -0,0 +1,97 @@
+#include <omp.h>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "kdtree.hpp"
+
+using namespace std;
+const int d = 4;
+const int d_dist = 2;
+
+typedef kdtree<int> index_t;
+
+float testval() {
+  static default_random_engine gen;
+  static normal_distribution<float> dist(0, 1);
+  return dist(gen);
+}
+
+double elapsed_us(chrono::high_resolution_clock::time_point t0) {
+  return chrono::duration<double, micro>(chrono::high_resolution_clock::now() - t0).count();
+}
+
+// Add n2 points one at a time, as give_feedback does with small batches
+void extend_index(index_t &index, int n2 = 1000000) {
+  vector<float> data2(n2 * d);
+  generate(data2.begin(), data2.end(), testval);
+
+  auto t1 = chrono::high_resolution_clock::now();
+  for (int i = 0; i < n2; i++) index.add(&data2[i * d], index.size());
+  cout << "Time to extend from " << (index.size() - n2) << " to " << index.size() << ": " << elapsed_us(t1) << endl;
+}
+
+// Usage: kdtree-test [threads] [n]
+int main(int argc, char **argv) {
+  int n = argc > 2 ? stoi(argv[2]) : 1000000;
+  int nn = 30;
+  if (argc > 1) omp_set_num_threads(stoi(argv[1]));
+
+  vector<float> data(n * d);
+  generate(data.begin(), data.end(), testval);
+  vector<int> payload(n);
+  for (int i = 0; i < n; i++) payload[i] = i;
+
+  int nq = 1000;
+  vector<float> qdata(nq * d_dist);
+  generate(qdata.begin(), qdata.end(), testval);
+
+  index_t index(d, d_dist);
+  auto t1 = chrono::high_resolution_clock::now();
+  index.add(&data[0], &payload[0], n);
+  cout << "Time to build index of " << n << ": " << elapsed_us(t1) << endl;
+
+  vector<int> indices(nq * nn), found(nq);
+  vector<float> dists(nq * nn);
+  auto t2 = chrono::high_resolution_clock::now();
+  index.knn_batch(&qdata[0], nq, nn, &indices[0], &dists[0], &found[0]);
+  cout << "Time to search " << nq << " queries: " << elapsed_us(t2) << endl;
+
+  // Compare the first queries with a full scan
+  int errors = 0;
+  for (int j = 0; j < 10; j++) {
+    vector<float> all(n);
+    for (int i = 0; i < n; i++) {
+      all[i] = 0;
+      for (int k = 0; k < d_dist; k++) {
+        float diff = qdata[j * d_dist + k] - data[i * d + k];
+        all[i] += diff * diff;
+      }
+    }
+    nth_element(all.begin(), all.begin() + nn - 1, all.end());
+    if (found[j] != nn || dists[j * nn + nn - 1] != all[nn - 1]) errors++;
+  }
+  cout << "Queries differing from full scan: " << errors << endl;
+
+  cout << "Nearest 5 to " << qdata[0] << "x" << qdata[1] << endl;
+  for (int j = 0; j < 5; j++) {
+    cout << "Dist = " << dists[j] << ": ";
+    auto p = index.point(indices[j]);
+    for (int i = 0; i < d; i++) {
+      cout << p[i] << ",";
+    }
+    cout << " payload " << index.payload(indices[j]) << endl;
+  }
+
+  index_t incremental(d, d_dist);
+  extend_index(incremental, n);
+  extend_index(incremental, n);
+
+  auto t3 = chrono::high_resolution_clock::now();
+  incremental.knn_batch(&qdata[0], nq, nn, &indices[0], &dists[0], &found[0]);
+  cout << "Time to search " << nq << " queries after extending: " << elapsed_us(t3) << endl;
+
+  return 0;
+}
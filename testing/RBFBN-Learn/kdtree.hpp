@@ -0,0 +1,254 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <vector>
+
+// Incremental KD-tree over float points with a payload per point. The distance is squared L2 over the first d_dist
+// dims only, so further columns can be stored with the points without affecting the search. A point keeps its index
+// for good, so payloads and points can be looked up by index however the tree changes.
+// Points are added to the leaf they fall in. When a subtree gets too unbalanced it is rebuilt at the median of its
+// widest dimension (scapegoat style), which keeps the depth O(log n) at amortized O(log² n) per insertion. Leaves
+// keep their own copy of the distance columns, so a leaf scan reads contiguous memory.
+template <typename P>
+class kdtree {
+ public:
+  kdtree(int dim, int d_dist, int leaf_size = 16) : dim(dim), d_dist(d_dist), leaf_size(leaf_size) {
+    assert(d_dist <= dim);
+    clear();
+  }
+
+  int size() const { return payloads.size(); }
+  const float *point(int i) const { return &points[i * dim]; }
+  P &payload(int i) { return payloads[i]; }
+  const P &payload(int i) const { return payloads[i]; }
+
+  void clear() {
+    points.clear();
+    payloads.clear();
+    nodes.assign(1, node());
+    free_nodes.clear();
+  }
+
+  // Add one point of dim values, returns its index
+  int add(const float *x, const P &p) {
+    const int i = size();
+    points.insert(points.end(), x, x + dim);
+    payloads.push_back(p);
+    insert(i);
+    return i;
+  }
+
+  // Add n points, a batch that is large relative to the tree is added by rebuilding it
+  void add(const float *x, const P *p, int n) {
+    points.insert(points.end(), x, x + n * dim);
+    payloads.insert(payloads.end(), p, p + n);
+    if (n > size() / 4) {
+      rebuild();
+    } else {
+      for (int i = size() - n; i < size(); i++) insert(i);
+    }
+  }
+
+  void rebuild() {
+    std::vector<int> ids(size());
+    for (int i = 0; i < size(); i++) ids[i] = i;
+    nodes.assign(1, node());
+    free_nodes.clear();
+    build(0, ids.begin(), ids.end());
+  }
+
+  // Exact k nearest neighbors of q, which needs d_dist values. Writes indices and squared distances sorted by
+  // distance and returns the number found.
+  int knn(const float *q, int k, int *idx, float *d2) const {
+    std::vector<std::pair<float, int>> heap;
+    heap.reserve(k + 1);
+    std::vector<float> off(d_dist, 0);
+    search(0, q, 0, off.data(), k, heap);
+
+    std::sort_heap(heap.begin(), heap.end());
+    for (int j = 0; j < heap.size(); j++) {
+      d2[j] = heap[j].first;
+      idx[j] = heap[j].second;
+    }
+    return heap.size();
+  }
+
+  // k nearest neighbors of nq queries with stride d_dist, in parallel. Row j of idx and d2 holds the result of query
+  // j, found[j] the number of neighbors in it.
+  void knn_batch(const float *q, int nq, int k, int *idx, float *d2, int *found) const {
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int j = 0; j < nq; j++) {
+      found[j] = knn(q + j * d_dist, k, idx + j * k, d2 + j * k);
+    }
+  }
+
+ private:
+  // Leaves have split < 0 and hold point indices with their distance columns
+  struct node {
+    int split = -1;
+    float value = 0;
+    int child[2] = {0, 0};
+    int count = 0;
+    std::vector<int> ids;
+    std::vector<float> coords;
+  };
+
+  int dim, d_dist, leaf_size;
+  std::vector<float> points;
+  std::vector<P> payloads;
+  std::vector<node> nodes;
+  std::vector<int> free_nodes;
+
+  static constexpr float max_imbalance = 0.75;
+
+  int new_node() {
+    if (free_nodes.empty()) {
+      nodes.emplace_back();
+      return nodes.size() - 1;
+    }
+    const int n = free_nodes.back();
+    free_nodes.pop_back();
+    nodes[n] = node();
+    return n;
+  }
+
+  void insert(int i) {
+    const float *x = point(i);
+    std::vector<int> path;
+    int n = 0;
+    while (nodes[n].split >= 0) {
+      nodes[n].count++;
+      path.push_back(n);
+      n = nodes[n].child[x[nodes[n].split] >= nodes[n].value];
+    }
+    nodes[n].count++;
+    nodes[n].ids.push_back(i);
+    nodes[n].coords.insert(nodes[n].coords.end(), x, x + d_dist);
+
+    // Rebuild the highest subtree on the path with one side much larger than the other, or else split the leaf
+    for (int m : path) {
+      const int larger = std::max(nodes[nodes[m].child[0]].count, nodes[nodes[m].child[1]].count);
+      if (nodes[m].count > 4 * leaf_size && larger > max_imbalance * nodes[m].count) {
+        rebuild_subtree(m);
+        return;
+      }
+    }
+    if (nodes[n].ids.size() > 2 * leaf_size) rebuild_subtree(n);
+  }
+
+  void collect(int n, std::vector<int> &ids) {
+    if (nodes[n].split < 0) {
+      ids.insert(ids.end(), nodes[n].ids.begin(), nodes[n].ids.end());
+      return;
+    }
+    for (int c : nodes[n].child) {
+      collect(c, ids);
+      free_nodes.push_back(c);
+    }
+  }
+
+  void rebuild_subtree(int n) {
+    std::vector<int> ids;
+    ids.reserve(nodes[n].count);
+    collect(n, ids);
+    build(n, ids.begin(), ids.end());
+  }
+
+  void build(int n, std::vector<int>::iterator first, std::vector<int>::iterator last) {
+    const int count = last - first;
+    nodes[n].count = count;
+    nodes[n].split = -1;
+    nodes[n].ids.clear();
+    nodes[n].coords.clear();
+
+    // Dimension with the widest spread
+    int s = -1;
+    if (count > leaf_size) {
+      float spread = 0;
+      for (int d = 0; d < d_dist; d++) {
+        float lo = point(*first)[d], hi = lo;
+        for (auto it = first; it != last; it++) {
+          lo = std::min(lo, point(*it)[d]);
+          hi = std::max(hi, point(*it)[d]);
+        }
+        if (hi - lo > spread) {
+          spread = hi - lo;
+          s = d;
+        }
+      }
+    }
+
+    if (s < 0) {
+      nodes[n].ids.assign(first, last);
+      nodes[n].coords.reserve(count * d_dist);
+      for (auto it = first; it != last; it++) nodes[n].coords.insert(nodes[n].coords.end(), point(*it), point(*it) + d_dist);
+      return;
+    }
+
+    // Split at the median, points equal to the split value go right. If the median is the smallest value split at
+    // the next value above it.
+    auto coord = [this, s](int i) { return point(i)[s]; };
+    auto less = [&](int a, int b) { return coord(a) < coord(b); };
+    auto mid = first + count / 2;
+    std::nth_element(first, mid, last, less);
+    const float median = coord(*mid);
+    float value = median;
+    auto lo = std::partition(first, last, [&](int i) { return coord(i) < value; });
+    if (lo == first) {
+      value = std::numeric_limits<float>::max();
+      for (auto it = first; it != last; it++) {
+        if (coord(*it) > median) value = std::min(value, coord(*it));
+      }
+      lo = std::partition(first, last, [&](int i) { return coord(i) < value; });
+    }
+
+    const int c0 = new_node();
+    const int c1 = new_node();
+    nodes[n].split = s;
+    nodes[n].value = value;
+    nodes[n].child[0] = c0;
+    nodes[n].child[1] = c1;
+    nodes[n].ids.shrink_to_fit();
+    nodes[n].coords.shrink_to_fit();
+    build(c0, first, lo);
+    build(c1, lo, last);
+  }
+
+  // Visit the near side first, and the far side if its box is closer than the k-th best. rd is the squared distance
+  // from q to the box of node n, built up from the offsets off to the splits on the way down.
+  void search(int n, const float *q, float rd, float *off, int k, std::vector<std::pair<float, int>> &heap) const {
+    const node &x = nodes[n];
+    if (x.split < 0) {
+      for (int j = 0; j < x.ids.size(); j++) {
+        const float *c = &x.coords[j * d_dist];
+        float d2 = 0;
+        for (int d = 0; d < d_dist; d++) d2 += (q[d] - c[d]) * (q[d] - c[d]);
+
+        if (heap.size() < k) {
+          heap.push_back({d2, x.ids[j]});
+          std::push_heap(heap.begin(), heap.end());
+        } else if (d2 < heap.front().first) {
+          std::pop_heap(heap.begin(), heap.end());
+          heap.back() = {d2, x.ids[j]};
+          std::push_heap(heap.begin(), heap.end());
+        }
+      }
+      return;
+    }
+
+    const float diff = q[x.split] - x.value;
+    search(x.child[diff >= 0], q, rd, off, k, heap);
+
+    const float old = off[x.split];
+    const float rd_far = rd - old * old + diff * diff;
+    if (heap.size() < k || rd_far < heap.front().first) {
+      off[x.split] = diff;
+      search(x.child[diff < 0], q, rd_far, off, k, heap);
+      off[x.split] = old;
+    }
+  }
+};